@@ -0,0 +1,92 @@
+# Runs dabu_cli on a generated store and checks its structured output:
+#   cmake -DCLI=<dabu_cli> -DBLOB=<store.blob> -DENTRIES=<count> -P check_cli.cmake
+
+function(run_cli out_var status_var)
+    execute_process(COMMAND ${CLI} ${ARGN}
+        OUTPUT_VARIABLE out
+        ERROR_VARIABLE err
+        RESULT_VARIABLE status)
+    set(${out_var} "${out}" PARENT_SCOPE)
+    set(${status_var} "${status}" PARENT_SCOPE)
+endfunction()
+
+function(split_lines out_var text)
+    string(REGEX REPLACE "\n$" "" text "${text}")
+    string(REPLACE "\n" ";" lines "${text}")
+    set(${out_var} "${lines}" PARENT_SCOPE)
+endfunction()
+
+# ndjson: one object per entry with every field of the record.
+run_cli(ndjson status --format=ndjson ${BLOB})
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "--format=ndjson exited with ${status}")
+endif()
+
+split_lines(records "${ndjson}")
+list(LENGTH records count)
+if(NOT count EQUAL ENTRIES)
+    message(FATAL_ERROR "--format=ndjson printed ${count} records, expected ${ENTRIES}")
+endif()
+
+set(ndjson_names "")
+foreach(record IN LISTS records)
+    if(NOT record MATCHES "^{\"name\":\"([^\"]+\\.dll)\",\"hash32\":\"0x[0-9a-f]+\",\"hash64\":\"0x[0-9a-f]+\",\"index\":[0-9]+,\"data_offset\":[0-9]+,\"compressed_size\":[0-9]+,\"size\":[1-9][0-9]*,\"store_id\":0,\"debug_data_offset\":[0-9]+,\"debug_data_size\":[0-9]+,\"config_data_offset\":[0-9]+,\"config_data_size\":[0-9]+}$")
+        message(FATAL_ERROR "malformed ndjson record: ${record}")
+    endif()
+    list(APPEND ndjson_names "${CMAKE_MATCH_1}")
+endforeach()
+
+# tsv: a header, then one row of 14 columns per entry in the same order.
+run_cli(tsv status --format=tsv ${BLOB})
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "--format=tsv exited with ${status}")
+endif()
+
+split_lines(rows "${tsv}")
+list(GET rows 0 header)
+list(REMOVE_AT rows 0)
+set(expected_header "name\thash32\thash64\tindex\tdata_offset\tcompressed_size\tsize\tstore_id\tabi\tdebug_data_offset\tdebug_data_size\tconfig_data_offset\tconfig_data_size\tobject")
+if(NOT header STREQUAL expected_header)
+    message(FATAL_ERROR "unexpected tsv header: ${header}")
+endif()
+
+list(LENGTH rows count)
+if(NOT count EQUAL ENTRIES)
+    message(FATAL_ERROR "--format=tsv printed ${count} rows, expected ${ENTRIES}")
+endif()
+
+set(tsv_names "")
+foreach(row IN LISTS rows)
+    if(NOT row MATCHES "^([^\t]+\\.dll)\t0x[0-9a-f]+\t0x[0-9a-f]+\t[0-9]+\t[0-9]+\t[0-9]+\t[1-9][0-9]*\t0\t\t[0-9]+\t[0-9]+\t[0-9]+\t[0-9]+\t$")
+        message(FATAL_ERROR "malformed tsv row: ${row}")
+    endif()
+    list(APPEND tsv_names "${CMAKE_MATCH_1}")
+endforeach()
+
+if(NOT ndjson_names STREQUAL tsv_names)
+    message(FATAL_ERROR "ndjson and tsv list different entries")
+endif()
+
+# json: the same records as one array, parsed where CMake can.
+run_cli(json status --format=json ${BLOB})
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "--format=json exited with ${status}")
+endif()
+
+if(NOT CMAKE_VERSION VERSION_LESS 3.19)
+    string(JSON length ERROR_VARIABLE json_error LENGTH "${json}")
+    if(json_error OR NOT length EQUAL ENTRIES)
+        message(FATAL_ERROR "--format=json printed ${length} records ${json_error}")
+    endif()
+endif()
+
+# Filters that match nothing are not an error, an unreadable blob is.
+run_cli(none status --format=ndjson --include "No.Such.Assembly*" ${BLOB})
+if(NOT status EQUAL 0 OR NOT none STREQUAL "")
+    message(FATAL_ERROR "an empty filter result exited with ${status}")
+endif()
+
+run_cli(missing status ${BLOB}.missing)
+if(status EQUAL 0)
+    message(FATAL_ERROR "a missing blob exited with 0")
+endif()
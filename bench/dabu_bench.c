@@ -0,0 +1,239 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "../dabu.h"
+
+/*
+ * Times the three ways of using the library on the given blobs: listing
+ * names only, decompressing every payload into memory, and extracting every
+ * payload to disk. Extraction runs on links to the blob in a temporary
+ * directory, removed afterwards, so the corpus is left untouched. Reports entries/s and MB/s of
+ * decompressed data for each mode.
+ */
+
+typedef enum {
+    MODE_LIST,
+    MODE_DECOMPRESS,
+    MODE_EXTRACT,
+    MODE_COUNT
+} mode_T;
+
+const char *mode_names[MODE_COUNT] = { "list-only", "decompress", "extract" };
+
+double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
+
+size_t
+run_mode(const char *path, const mode_T mode, const unsigned int jobs, uint64_t *bytes)
+{
+    assembly_table_T table = { 0 };
+    block_T *block = NULL;
+    dump_options_T options = { 0 };
+
+    options.jobs = jobs;
+    options.list_only = (mode == MODE_LIST);
+    options.dump = (mode == MODE_EXTRACT);
+
+    size_t count = assemblies_dump_options(&block, path, &table, &options);
+
+    *bytes = 0;
+    for (size_t i = 0; i < count; i++)
+        *bytes += table.entries[i].size;
+
+    block_free(&block);
+
+    return count;
+}
+
+/*
+ * Links the blob and every file sharing its stem (manifest, per-ABI stores)
+ * into the new directory dir, extraction writes its output next to the path
+ * it is given. Returns the path of the link to the blob, NULL on failure.
+ */
+char*
+stage_blob(const char *path, char *dir)
+{
+    char source[PATH_MAX];
+    if (!realpath(path, source) || !mkdtemp(dir))
+        return NULL;
+
+    char *base = strrchr(source, '/');
+    *base++ = '\0';
+
+    const char *ext = strrchr(base, '.');
+    const size_t stem_len = ext ? (size_t)(ext - base) : strlen(base);
+
+    DIR *parent = opendir(*source ? source : "/");
+    if (!parent) return NULL;
+
+    char *staged = NULL;
+    struct dirent *ent = NULL;
+    while ((ent = readdir(parent)) != NULL)
+    {
+        if (strncmp(ent->d_name, base, stem_len) != 0 || ent->d_name[stem_len] != '.')
+            continue;
+
+        char target[PATH_MAX];
+        char link_path[PATH_MAX];
+        if (snprintf(target, sizeof(target), "%s/%s", source, ent->d_name) >= (int)sizeof(target)
+                || snprintf(link_path, sizeof(link_path), "%s/%s", dir, ent->d_name) >= (int)sizeof(link_path)
+                || symlink(target, link_path) < 0)
+        {
+            free(staged);
+            staged = NULL;
+            break;
+        }
+
+        if (strcmp(ent->d_name, base) == 0)
+            staged = strdup(link_path);
+    }
+
+    closedir(parent);
+    return staged;
+}
+
+int
+remove_path(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+int
+bench_blob(const char *path, const int rounds, const unsigned int jobs, const bool modes[MODE_COUNT])
+{
+    uint64_t bytes = 0;
+    const char *tmp = getenv("TMPDIR");
+    char dir[PATH_MAX];
+    char *staged = NULL;
+
+    // Warm the page cache so every mode starts from the same state.
+    if (!run_mode(path, MODE_DECOMPRESS, jobs, &bytes))
+    {
+        fprintf(stderr, "failed loading %s\n", path);
+        return -1;
+    }
+
+    printf("%s: %.1f MiB decompressed, %d rounds, %u jobs\n", path,
+            (double)bytes / (1024.0 * 1024.0), rounds, jobs ? jobs : 1);
+
+    for (int mode = 0; mode < MODE_COUNT; mode++)
+    {
+        if (!modes[mode])
+            continue;
+
+        const char *run_path = path;
+        if (mode == MODE_EXTRACT)
+        {
+            snprintf(dir, sizeof(dir), "%s/dabu_bench.XXXXXX", (tmp && *tmp) ? tmp : "/tmp");
+            staged = stage_blob(path, dir);
+            if (!staged)
+            {
+                fprintf(stderr, "failed staging %s in %s\n", path, dir);
+                nftw(dir, remove_path, 16, FTW_DEPTH | FTW_PHYS);
+                return -1;
+            }
+
+            run_path = staged;
+        }
+
+        size_t entries = 0;
+        const double start = now();
+
+        for (int r = 0; r < rounds; r++)
+            entries += run_mode(run_path, (mode_T)mode, jobs, &bytes);
+
+        const double elapsed = now() - start;
+        const double mb = ((double)bytes * rounds) / (1024.0 * 1024.0);
+
+        if (mode == MODE_LIST)
+            printf("  %-10s %12.0f entries/s\n", mode_names[mode], (double)entries / elapsed);
+        else
+            printf("  %-10s %12.0f entries/s %10.1f MB/s\n", mode_names[mode], (double)entries / elapsed, mb / elapsed);
+
+        if (staged)
+        {
+            nftw(dir, remove_path, 16, FTW_DEPTH | FTW_PHYS);
+            free(staged);
+            staged = NULL;
+        }
+    }
+
+    return 0;
+}
+
+int
+help(const char *prog)
+{
+    fprintf(stderr, "%s [-n rounds] [-j jobs] [--mode list|decompress|extract|all] <blob file>...\n", prog);
+    return -1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    bool modes[MODE_COUNT] = { true, true, true };
+    unsigned int jobs = 0;
+    int rounds = 10;
+    int first = argc;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const bool has_value = (i + 1) < argc;
+
+        if (strcmp(arg, "-n") == 0 && has_value)
+            rounds = atoi(argv[++i]);
+        else if (strcmp(arg, "-j") == 0 && has_value)
+            jobs = (unsigned int)atoi(argv[++i]);
+        else if (strcmp(arg, "--mode") == 0 && has_value)
+        {
+            const char *name = argv[++i];
+
+            if (strcmp(name, "all") != 0)
+            {
+                memset(modes, 0, sizeof(modes));
+
+                if (strcmp(name, "list") == 0) modes[MODE_LIST] = true;
+                else if (strcmp(name, "decompress") == 0) modes[MODE_DECOMPRESS] = true;
+                else if (strcmp(name, "extract") == 0) modes[MODE_EXTRACT] = true;
+                else return help(argv[0]);
+            }
+        }
+        else if (arg[0] == '-')
+            return help(argv[0]);
+        else
+        {
+            first = i;
+            break;
+        }
+    }
+
+    if (first >= argc || rounds <= 0)
+        return help(argv[0]);
+
+    int ret = 0;
+    for (int i = first; i < argc; i++)
+    {
+        if (bench_blob(argv[i], rounds, jobs, modes) < 0)
+            ret = -1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,837 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "../lz4.h"
+
+#include "../dabu.h"
+#include "../dabu_format.h"
+
+/*
+ * Writes a synthetic AssemblyStore: <stem>.blob in the XABA layout used by
+ * dabu (header, descriptors, hash32 and hash64 index, XALZ wrapped LZ4
+ * payloads) and the matching <stem>.manifest. Payload sizes follow a uniform
+ * or log-normal distribution, compressibility is the share of each payload
+ * made of repeated tokens instead of random bytes. With --stored the
+ * payloads are written as plain PE images, like stores built without
+ * compression.
+ *
+ * --apk and --aab also wrap the store in <stem>.apk and <stem>.aab, with the
+ * blob and manifest stored under assemblies/ (base/root/assemblies/ in the
+ * AAB), 4 byte aligned like zipalign leaves them. --zip64 writes the
+ * archives with ZIP64 records and --deflate deflates the blob member, which
+ * readers have to reject.
+ *
+ * --extras gives every third assembly debug symbols and every fifth a
+ * .config payload, written behind the assembly and compressed like it.
+ *
+ * --abis arm64-v8a,x86_64 writes a split store set instead: <stem>.blob
+ * holds the shared assemblies and the index of every store, store id 0, and
+ * each <stem>.<abi>.blob the per-ABI copies of the others, store id 1.
+ */
+
+#define GEN_MAX_ABIS 8
+#define GEN_ABI_SIZE 32
+
+typedef struct {
+    uint32_t entries;
+    uint32_t min_size;
+    uint32_t max_size;
+    double compressibility;
+    bool lognormal;
+    bool stored;
+    uint64_t seed;
+    const char *stem;
+    bool apk;
+    bool aab;
+    bool zip64;
+    bool deflate;
+    bool extras;
+    const char *abis[GEN_MAX_ABIS];
+    size_t abi_count;
+} gen_options_T;
+
+typedef struct {
+    uint32_t hash32;
+    uint64_t hash64;
+    uint32_t index;
+    uint32_t store_id;
+    uint32_t local_index;
+    char name[64];
+} gen_entry_T;
+
+uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+/*
+ * splitmix64, good enough for test data and identical on every platform.
+ */
+uint64_t
+rng_next(void)
+{
+    uint64_t z = (rng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+double
+rng_unit(void)
+{
+    return (double)(rng_next() >> 11) / (double)(1ULL << 53);
+}
+
+uint32_t
+pick_size(const gen_options_T *options)
+{
+    const double lo = options->min_size;
+    const double hi = options->max_size;
+
+    if (!options->lognormal)
+        return (uint32_t)(lo + (rng_unit() * (hi - lo)));
+
+    // Box-Muller; most assemblies are small, a few are very large.
+    const double u1 = rng_unit() + 1e-12;
+    const double u2 = rng_unit();
+    const double normal = sqrt(-2.0 * log(u1)) * cos(2.0 * 3.14159265358979323846 * u2);
+    const double mu = log(sqrt(lo * hi));
+    const double sigma = (log(hi) - log(lo)) / 6.0;
+
+    double size = exp(mu + (sigma * normal));
+    if (size < lo) size = lo;
+    if (size > hi) size = hi;
+
+    return (uint32_t)size;
+}
+
+void
+fill_payload(uint8_t *data, const uint32_t size, const double compressibility)
+{
+    static const char *tokens[] = {
+        "System.Runtime", "get_Item", "set_Value", "Invoke", ".ctor", "Xamarin.Forms",
+        "Android.Views", "<Module>", "mscorlib", "IDisposable", "ToString", "Equals"
+    };
+    const size_t token_count = sizeof(tokens) / sizeof(tokens[0]);
+
+    uint32_t pos = 0;
+
+    // Every payload looks like a PE image to tools that sniff the first bytes.
+    if (size >= 2)
+    {
+        data[pos++] = 'M';
+        data[pos++] = 'Z';
+    }
+
+    while (pos < size)
+    {
+        if (rng_unit() < compressibility)
+        {
+            const char *token = tokens[rng_next() % token_count];
+            for (size_t i = 0; token[i] && pos < size; i++)
+                data[pos++] = (uint8_t)token[i];
+        }
+        else
+        {
+            const uint64_t noise = rng_next();
+            for (size_t i = 0; i < 8 && pos < size; i++)
+                data[pos++] = (uint8_t)(noise >> (i * 8));
+        }
+    }
+}
+
+int
+compare_hash32(const void *a, const void *b)
+{
+    const uint32_t x = ((const hash_T*)a)->hash32;
+    const uint32_t y = ((const hash_T*)b)->hash32;
+    return (x > y) - (x < y);
+}
+
+int
+compare_hash64(const void *a, const void *b)
+{
+    const uint64_t x = ((const hash_T*)a)->hash64;
+    const uint64_t y = ((const hash_T*)b)->hash64;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Writes one payload at *offset, XALZ wrapped and LZ4 compressed unless the
+ * store is --stored, and returns its stored size. 0 on failure.
+ */
+uint32_t
+write_payload(FILE *blob, const gen_options_T *options, const uint8_t *payload, const uint32_t size, const uint32_t index, char *compressed)
+{
+    if (options->stored)
+        return fwrite(payload, size, 1, blob) == 1 ? size : 0;
+
+    const int bound = LZ4_compressBound((int)size);
+    const int csize = LZ4_compress_default((const char*)payload, compressed, (int)size, bound);
+    if (csize <= 0)
+    {
+        fprintf(stderr, "LZ4_compress_default() failed for entry %u\n", index);
+        return 0;
+    }
+
+    xalz_T xalz = { XALZ_MAGIC, index, size };
+    if (fwrite(&xalz, sizeof(xalz), 1, blob) != 1 || fwrite(compressed, (size_t)csize, 1, blob) != 1)
+        return 0;
+
+    return (uint32_t)(sizeof(xalz_T) + (size_t)csize);
+}
+
+/*
+ * The debug symbols of an --extras assembly: a portable PDB signature and
+ * its name over and over. They do not draw from the random stream, so the
+ * assemblies stay those of the same seed without --extras.
+ */
+uint32_t
+fill_debug(uint8_t *data, const gen_entry_T *entry, const uint32_t cap)
+{
+    const uint32_t size = 256 + ((entry->index * 37) % 1024);
+    const size_t name_len = strlen(entry->name);
+    uint32_t pos = 0;
+
+    for (; pos < size && pos < cap; pos++)
+        data[pos] = (pos < 4) ? (uint8_t)"BSJB"[pos] : (uint8_t)entry->name[(pos - 4) % name_len];
+
+    return pos;
+}
+
+uint32_t
+fill_config(uint8_t *data, const gen_entry_T *entry, const uint32_t cap)
+{
+    const int len = snprintf((char*)data, cap,
+            "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<configuration>\n  <!-- %s -->\n</configuration>\n", entry->name);
+
+    return (len < 0) ? 0 : ((uint32_t)len < cap ? (uint32_t)len : cap - 1);
+}
+
+/*
+ * Writes one store file: header, descriptors, the index tables when given
+ * (only the primary store has them) and the payloads of entries, the
+ * entries the file holds in local index order. abi, when set, is stamped
+ * behind the "MZ" of every payload so the copies of an assembly differ
+ * between ABIs.
+ */
+int
+write_store(
+        const gen_options_T *options,
+        const char *path,
+        const gen_entry_T *const *entries,
+        const uint32_t n,
+        const hash_T *hash32list,
+        const hash_T *hash64list,
+        const uint32_t index_count,
+        const uint32_t store_id,
+        const char *abi,
+        uint64_t *raw_total,
+        uint64_t *stored_total)
+{
+    FILE *blob = fopen(path, "wb");
+    descriptor_T *descriptors = calloc(n ? n : 1, sizeof(descriptor_T));
+    uint8_t *payload = malloc(options->max_size);
+    char *compressed = malloc((size_t)LZ4_compressBound((int)options->max_size));
+    int ret = -1;
+
+    if (!blob || !descriptors || !payload || !compressed)
+    {
+        fprintf(stderr, "failed setting up the generator for %s\n", path);
+        goto EXIT;
+    }
+
+    header_T header = { XABA_MAGIC, 1, n, index_count, store_id };
+    const long data_start = (long)(sizeof(header_T) + (n * sizeof(descriptor_T)) + (2 * index_count * sizeof(hash_T)));
+
+    if (fseek(blob, data_start, SEEK_SET) != 0)
+        goto EXIT;
+
+    uint64_t offset = (uint64_t)data_start;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const uint32_t size = pick_size(options);
+        fill_payload(payload, size, options->compressibility);
+
+        if (abi && size >= 2 + strlen(abi))
+            memcpy(payload + 2, abi, strlen(abi));
+
+        descriptors[i].data_offset = (uint32_t)offset;
+        descriptors[i].data_size = write_payload(blob, options, payload, size, i, compressed);
+        if (!descriptors[i].data_size)
+            goto EXIT;
+
+        offset += descriptors[i].data_size;
+        *raw_total += size;
+
+        // The extras follow their assembly, as the build lays them out.
+        if (options->extras && (entries[i]->index % 3) == 0)
+        {
+            const uint32_t extra = fill_debug(payload, entries[i], options->max_size);
+
+            descriptors[i].debug_data_offset = (uint32_t)offset;
+            descriptors[i].debug_data_size = write_payload(blob, options, payload, extra, i, compressed);
+            if (!descriptors[i].debug_data_size)
+                goto EXIT;
+
+            offset += descriptors[i].debug_data_size;
+            *raw_total += extra;
+        }
+
+        if (options->extras && (entries[i]->index % 5) == 0)
+        {
+            const uint32_t extra = fill_config(payload, entries[i], options->max_size);
+
+            descriptors[i].config_data_offset = (uint32_t)offset;
+            descriptors[i].config_data_size = write_payload(blob, options, payload, extra, i, compressed);
+            if (!descriptors[i].config_data_size)
+                goto EXIT;
+
+            offset += descriptors[i].config_data_size;
+            *raw_total += extra;
+        }
+
+        if (offset > UINT32_MAX)
+        {
+            fprintf(stderr, "store larger than 4 GiB, reduce the entry count or sizes\n");
+            goto EXIT;
+        }
+    }
+
+    *stored_total += offset;
+
+    if (fseek(blob, 0, SEEK_SET) != 0
+            || fwrite(&header, sizeof(header), 1, blob) != 1
+            || fwrite(descriptors, sizeof(descriptor_T), n, blob) != n
+            || (index_count && fwrite(hash32list, sizeof(hash_T), index_count, blob) != index_count)
+            || (index_count && fwrite(hash64list, sizeof(hash_T), index_count, blob) != index_count))
+        goto EXIT;
+
+    ret = 0;
+
+EXIT:
+    if (blob && fclose(blob) != 0)
+        ret = -1;
+
+    free(descriptors);
+    free(payload);
+    free(compressed);
+
+    return ret;
+}
+
+/*
+ * Per-ABI builds keep every fourth assembly that is not a satellite one in
+ * the per-ABI stores, store id 1; the others are shared.
+ */
+bool
+is_per_abi(const gen_options_T *options, const uint32_t index)
+{
+    return options->abi_count && (index % 4) == 3 && (index % 10) != 9;
+}
+
+int
+generate(const gen_options_T *options)
+{
+    const uint32_t n = options->entries;
+    char path[4096];
+    int ret = -1;
+
+    snprintf(path, sizeof(path), "%s.manifest", options->stem);
+    FILE *manifest = fopen(path, "w");
+
+    hash_T *hash32list = calloc(n, sizeof(hash_T));
+    hash_T *hash64list = calloc(n, sizeof(hash_T));
+    gen_entry_T *entries = calloc(n, sizeof(gen_entry_T));
+    const gen_entry_T **shared = calloc(n, sizeof(gen_entry_T*));
+    const gen_entry_T **per_abi = calloc(n, sizeof(gen_entry_T*));
+
+    if (!manifest || !hash32list || !hash64list || !entries || !shared || !per_abi)
+    {
+        fprintf(stderr, "failed setting up the generator for %s\n", options->stem);
+        goto EXIT;
+    }
+
+    rng_state = options->seed;
+
+    uint32_t shared_count = 0;
+    uint32_t per_abi_count = 0;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        entries[i].index = i;
+
+        // Every tenth assembly is a satellite assembly with a culture prefix.
+        if ((i % 10) == 9)
+            snprintf(entries[i].name, sizeof(entries[i].name), "fr/Bench.Assembly%u.resources", i);
+        else
+            snprintf(entries[i].name, sizeof(entries[i].name), "Bench.Assembly%u", i);
+
+        // Hashed the way the runtime indexes names, so lookups work.
+        entries[i].hash32 = dabu_hash32(entries[i].name);
+        entries[i].hash64 = dabu_hash64(entries[i].name);
+
+        entries[i].store_id = is_per_abi(options, i) ? 1 : 0;
+        entries[i].local_index = entries[i].store_id ? per_abi_count : shared_count;
+
+        if (entries[i].store_id)
+            per_abi[per_abi_count++] = &entries[i];
+        else
+            shared[shared_count++] = &entries[i];
+
+        hash32list[i].hash32 = entries[i].hash32;
+        hash32list[i].mapping_index = i;
+        hash32list[i].local_store_index = entries[i].local_index;
+        hash32list[i].store_id = entries[i].store_id;
+        hash64list[i].hash64 = entries[i].hash64;
+        hash64list[i].mapping_index = i;
+        hash64list[i].local_store_index = entries[i].local_index;
+        hash64list[i].store_id = entries[i].store_id;
+    }
+
+    // The runtime binary searches both index tables.
+    qsort(hash32list, n, sizeof(hash_T), compare_hash32);
+    qsort(hash64list, n, sizeof(hash_T), compare_hash64);
+
+    uint64_t raw_total = 0;
+    uint64_t stored_total = 0;
+
+    snprintf(path, sizeof(path), "%s.blob", options->stem);
+    if (write_store(options, path, shared, shared_count, hash32list, hash64list, n, 0, NULL, &raw_total, &stored_total) < 0)
+        goto EXIT;
+
+    for (size_t a = 0; a < options->abi_count; a++)
+    {
+        snprintf(path, sizeof(path), "%s.%s.blob", options->stem, options->abis[a]);
+        if (write_store(options, path, per_abi, per_abi_count, NULL, NULL, 0, 1, options->abis[a], &raw_total, &stored_total) < 0)
+            goto EXIT;
+    }
+
+    fprintf(manifest, "Hash 32     Hash 64             Blob ID  Blob idx  Name\n");
+    for (uint32_t i = 0; i < n; i++)
+    {
+        fprintf(manifest, "0x%08x  0x%016llx  %03u      %04u      %s\n",
+                entries[i].hash32, (unsigned long long)entries[i].hash64, entries[i].store_id, entries[i].local_index, entries[i].name);
+    }
+
+    if (options->abi_count)
+    {
+        printf("%s.blob: %u entries, %u in %zu per-ABI stores, %.1f MiB raw, %.1f MiB stored\n", options->stem, n,
+                per_abi_count, options->abi_count, (double)raw_total / (1024.0 * 1024.0), (double)stored_total / (1024.0 * 1024.0));
+    }
+    else
+    {
+        printf("%s.blob: %u entries, %.1f MiB raw, %.1f MiB stored\n", options->stem, n,
+                (double)raw_total / (1024.0 * 1024.0), (double)stored_total / (1024.0 * 1024.0));
+    }
+
+    ret = 0;
+
+EXIT:
+    if (ret < 0)
+        fprintf(stderr, "failed writing %s\n", options->stem);
+
+    if (manifest) fclose(manifest);
+
+    free(hash32list);
+    free(hash64list);
+    free(entries);
+    free(shared);
+    free(per_abi);
+
+    return ret;
+}
+
+#define ZIP_ALIGN 4
+#define ZIP_MAX_MEMBERS (GEN_MAX_ABIS + 3)
+#define DEFLATE_BLOCK 0xFFFF
+
+typedef struct {
+    char name[128];
+    uint64_t offset;
+    uint64_t size;
+    uint64_t compressed;
+    uint32_t crc;
+    uint16_t method;
+} zip_member_T;
+
+typedef struct {
+    FILE *file;
+    uint64_t offset;
+    bool zip64;
+    zip_member_T members[ZIP_MAX_MEMBERS];
+    size_t count;
+} zip_writer_T;
+
+/*
+ * CRC-32 of the ZIP format, bitwise; the archives are small.
+ */
+uint32_t
+crc32_update(uint32_t crc, const uint8_t *data, const size_t size)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+    }
+
+    return ~crc;
+}
+
+void
+put_u16(uint8_t *p, const uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+}
+
+void
+put_u32(uint8_t *p, const uint32_t value)
+{
+    put_u16(p, (uint16_t)value);
+    put_u16(p + 2, (uint16_t)(value >> 16));
+}
+
+void
+put_u64(uint8_t *p, const uint64_t value)
+{
+    put_u32(p, (uint32_t)value);
+    put_u32(p + 4, (uint32_t)(value >> 32));
+}
+
+bool
+zip_write(zip_writer_T *zip, const void *data, const size_t size)
+{
+    zip->offset += size;
+    return !size || fwrite(data, size, 1, zip->file) == 1;
+}
+
+uint8_t*
+read_whole(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    uint8_t *data = NULL;
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+        const long end = ftell(file);
+        data = end >= 0 ? malloc((size_t)end + 1) : NULL;
+        *size = (size_t)end;
+
+        if (data && (fseek(file, 0, SEEK_SET) != 0 || (end > 0 && fread(data, (size_t)end, 1, file) != 1)))
+        {
+            free(data);
+            data = NULL;
+        }
+    }
+
+    fclose(file);
+    return data;
+}
+
+/*
+ * Deflates data with stored blocks only: a valid deflate stream, just not a
+ * smaller one.
+ */
+uint8_t*
+deflate_stored(const uint8_t *data, const size_t size, size_t *out_size)
+{
+    const size_t blocks = size ? (size + DEFLATE_BLOCK - 1) / DEFLATE_BLOCK : 1;
+    uint8_t *out = malloc(size + (blocks * 5));
+    if (!out) return NULL;
+
+    size_t pos = 0;
+    for (size_t block = 0; block < blocks; block++)
+    {
+        const size_t start = block * DEFLATE_BLOCK;
+        const uint16_t len = (uint16_t)((size - start) < DEFLATE_BLOCK ? (size - start) : DEFLATE_BLOCK);
+
+        out[pos++] = (block + 1 == blocks) ? 1 : 0;
+        put_u16(out + pos, len);
+        put_u16(out + pos + 2, (uint16_t)~len);
+        memcpy(out + pos + 4, data + start, len);
+        pos += 4 + (size_t)len;
+    }
+
+    *out_size = pos;
+    return out;
+}
+
+/*
+ * Adds the file at path as member name. Stored members start 4 byte
+ * aligned, the local extra field is padded for it.
+ */
+int
+zip_add(zip_writer_T *zip, const char *name, const char *path, const bool deflate)
+{
+    size_t size = 0;
+    size_t compressed_size = 0;
+    uint8_t *data = read_whole(path, &size);
+    uint8_t *deflated = (data && deflate) ? deflate_stored(data, size, &compressed_size) : NULL;
+
+    if (!data || (deflate && !deflated) || zip->count == ZIP_MAX_MEMBERS)
+    {
+        fprintf(stderr, "failed adding %s as %s\n", path, name);
+        free(data);
+        free(deflated);
+        return -1;
+    }
+
+    zip_member_T *member = &zip->members[zip->count++];
+    snprintf(member->name, sizeof(member->name), "%s", name);
+    member->offset = zip->offset;
+    member->size = size;
+    member->compressed = deflate ? compressed_size : size;
+    member->crc = crc32_update(0, data, size);
+    member->method = deflate ? 8 : 0;
+
+    const size_t name_len = strlen(member->name);
+    size_t extra_len = zip->zip64 ? 20 : 0;
+    if (!deflate)
+        extra_len += (ZIP_ALIGN - ((member->offset + 30 + name_len + extra_len) % ZIP_ALIGN)) % ZIP_ALIGN;
+
+    uint8_t local[30] = { 0 };
+    uint8_t extra[20 + ZIP_ALIGN] = { 0 };
+    put_u32(local, 0x04034b50);
+    put_u16(local + 4, zip->zip64 ? 45 : 20);
+    put_u16(local + 8, member->method);
+    put_u16(local + 12, 0x21);
+    put_u32(local + 14, member->crc);
+    put_u32(local + 18, zip->zip64 ? UINT32_MAX : (uint32_t)member->compressed);
+    put_u32(local + 22, zip->zip64 ? UINT32_MAX : (uint32_t)member->size);
+    put_u16(local + 26, (uint16_t)name_len);
+    put_u16(local + 28, (uint16_t)extra_len);
+
+    if (zip->zip64)
+    {
+        put_u16(extra, 0x0001);
+        put_u16(extra + 2, 16);
+        put_u64(extra + 4, member->size);
+        put_u64(extra + 12, member->compressed);
+    }
+
+    const bool ok = zip_write(zip, local, sizeof(local)) && zip_write(zip, member->name, name_len)
+        && zip_write(zip, extra, extra_len) && zip_write(zip, deflate ? deflated : data, member->compressed);
+
+    free(data);
+    free(deflated);
+
+    return ok ? 0 : -1;
+}
+
+/*
+ * Writes the central directory and the end records, ZIP64 ones included
+ * when the writer is in ZIP64 mode.
+ */
+int
+zip_finish(zip_writer_T *zip)
+{
+    const uint64_t cd_offset = zip->offset;
+    bool ok = true;
+
+    for (size_t i = 0; ok && i < zip->count; i++)
+    {
+        const zip_member_T *member = &zip->members[i];
+        const size_t name_len = strlen(member->name);
+
+        uint8_t central[46] = { 0 };
+        uint8_t extra[28] = { 0 };
+        put_u32(central, 0x02014b50);
+        put_u16(central + 4, zip->zip64 ? 45 : 20);
+        put_u16(central + 6, zip->zip64 ? 45 : 20);
+        put_u16(central + 10, member->method);
+        put_u16(central + 14, 0x21);
+        put_u32(central + 16, member->crc);
+        put_u32(central + 20, zip->zip64 ? UINT32_MAX : (uint32_t)member->compressed);
+        put_u32(central + 24, zip->zip64 ? UINT32_MAX : (uint32_t)member->size);
+        put_u16(central + 28, (uint16_t)name_len);
+        put_u16(central + 30, zip->zip64 ? sizeof(extra) : 0);
+        put_u32(central + 42, zip->zip64 ? UINT32_MAX : (uint32_t)member->offset);
+
+        put_u16(extra, 0x0001);
+        put_u16(extra + 2, 24);
+        put_u64(extra + 4, member->size);
+        put_u64(extra + 12, member->compressed);
+        put_u64(extra + 20, member->offset);
+
+        ok = zip_write(zip, central, sizeof(central)) && zip_write(zip, member->name, name_len)
+            && zip_write(zip, extra, zip->zip64 ? sizeof(extra) : 0);
+    }
+
+    const uint64_t cd_size = zip->offset - cd_offset;
+
+    if (ok && zip->zip64)
+    {
+        const uint64_t eocd64_offset = zip->offset;
+
+        uint8_t eocd64[56] = { 0 };
+        put_u32(eocd64, 0x06064b50);
+        put_u64(eocd64 + 4, sizeof(eocd64) - 12);
+        put_u16(eocd64 + 12, 45);
+        put_u16(eocd64 + 14, 45);
+        put_u64(eocd64 + 24, zip->count);
+        put_u64(eocd64 + 32, zip->count);
+        put_u64(eocd64 + 40, cd_size);
+        put_u64(eocd64 + 48, cd_offset);
+
+        uint8_t locator[20] = { 0 };
+        put_u32(locator, 0x07064b50);
+        put_u64(locator + 8, eocd64_offset);
+        put_u32(locator + 16, 1);
+
+        ok = zip_write(zip, eocd64, sizeof(eocd64)) && zip_write(zip, locator, sizeof(locator));
+    }
+
+    uint8_t eocd[22] = { 0 };
+    put_u32(eocd, 0x06054b50);
+    put_u16(eocd + 8, zip->zip64 ? UINT16_MAX : (uint16_t)zip->count);
+    put_u16(eocd + 10, zip->zip64 ? UINT16_MAX : (uint16_t)zip->count);
+    put_u32(eocd + 12, zip->zip64 ? UINT32_MAX : (uint32_t)cd_size);
+    put_u32(eocd + 16, zip->zip64 ? UINT32_MAX : (uint32_t)cd_offset);
+
+    return (ok && zip_write(zip, eocd, sizeof(eocd))) ? 0 : -1;
+}
+
+/*
+ * Wraps the generated store in <stem><ext>, its members under prefix.
+ */
+int
+write_archive(const gen_options_T *options, const char *ext, const char *prefix)
+{
+    char path[4096];
+    char name[128];
+    zip_writer_T zip = { 0 };
+    zip.zip64 = options->zip64;
+
+    snprintf(path, sizeof(path), "%s%s", options->stem, ext);
+    zip.file = fopen(path, "wb");
+    if (!zip.file)
+    {
+        fprintf(stderr, "failed creating %s\n", path);
+        return -1;
+    }
+
+    // A placeholder ahead of the store, as in a real package.
+    char placeholder[4096];
+    snprintf(placeholder, sizeof(placeholder), "%s.manifest", options->stem);
+    snprintf(name, sizeof(name), "%s", strcmp(ext, ".aab") == 0 ? "base/manifest/AndroidManifest.xml" : "AndroidManifest.xml");
+    int ret = zip_add(&zip, name, placeholder, false);
+
+    snprintf(path, sizeof(path), "%s.blob", options->stem);
+    snprintf(name, sizeof(name), "%sassemblies/assemblies.blob", prefix);
+    if (ret == 0)
+        ret = zip_add(&zip, name, path, options->deflate);
+
+    for (size_t a = 0; ret == 0 && a < options->abi_count; a++)
+    {
+        snprintf(path, sizeof(path), "%s.%s.blob", options->stem, options->abis[a]);
+        snprintf(name, sizeof(name), "%sassemblies/assemblies.%s.blob", prefix, options->abis[a]);
+        ret = zip_add(&zip, name, path, false);
+    }
+
+    snprintf(path, sizeof(path), "%s.manifest", options->stem);
+    snprintf(name, sizeof(name), "%sassemblies/assemblies.manifest", prefix);
+    if (ret == 0)
+        ret = zip_add(&zip, name, path, false);
+
+    if (ret == 0)
+        ret = zip_finish(&zip);
+
+    if (fclose(zip.file) != 0)
+        ret = -1;
+
+    if (ret < 0)
+        fprintf(stderr, "failed writing %s%s\n", options->stem, ext);
+    else
+        printf("%s%s: %zu members%s\n", options->stem, ext, zip.count, options->zip64 ? ", ZIP64" : "");
+
+    return ret;
+}
+
+int
+help(const char *prog)
+{
+    fprintf(stderr, "%s [options] <output stem>\n", prog);
+    fprintf(stderr, "  -n N            number of assemblies (default 300)\n");
+    fprintf(stderr, "  --min-size B    smallest payload in bytes (default 4096)\n");
+    fprintf(stderr, "  --max-size B    largest payload in bytes (default 1048576)\n");
+    fprintf(stderr, "  --uniform       uniform sizes instead of log-normal\n");
+    fprintf(stderr, "  --compress R    share of repeated tokens, 0.0-1.0 (default 0.7)\n");
+    fprintf(stderr, "  --stored        write payloads uncompressed, without XALZ headers\n");
+    fprintf(stderr, "  --seed S        random seed (default 1)\n");
+    fprintf(stderr, "  --apk           also wrap the store in <stem>.apk\n");
+    fprintf(stderr, "  --aab           also wrap the store in <stem>.aab, under base/root/\n");
+    fprintf(stderr, "  --zip64         write the archives with ZIP64 records\n");
+    fprintf(stderr, "  --deflate       deflate the blob member of the archives\n");
+    fprintf(stderr, "  --extras        add debug symbols and .config payloads to some assemblies\n");
+    fprintf(stderr, "  --abis A,B      split the store into a primary store and one store per ABI\n");
+    return -1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    gen_options_T options = { 300, 4096, 1024 * 1024, 0.7, true, false, 1, NULL };
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const bool has_value = (i + 1) < argc;
+
+        if (strcmp(arg, "-n") == 0 && has_value)
+            options.entries = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--min-size") == 0 && has_value)
+            options.min_size = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--max-size") == 0 && has_value)
+            options.max_size = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--compress") == 0 && has_value)
+            options.compressibility = atof(argv[++i]);
+        else if (strcmp(arg, "--seed") == 0 && has_value)
+            options.seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--uniform") == 0)
+            options.lognormal = false;
+        else if (strcmp(arg, "--stored") == 0)
+            options.stored = true;
+        else if (strcmp(arg, "--apk") == 0)
+            options.apk = true;
+        else if (strcmp(arg, "--aab") == 0)
+            options.aab = true;
+        else if (strcmp(arg, "--zip64") == 0)
+            options.zip64 = true;
+        else if (strcmp(arg, "--deflate") == 0)
+            options.deflate = true;
+        else if (strcmp(arg, "--extras") == 0)
+            options.extras = true;
+        else if (strcmp(arg, "--abis") == 0 && has_value)
+        {
+            for (char *abi = strtok(argv[++i], ","); abi; abi = strtok(NULL, ","))
+            {
+                if (options.abi_count == GEN_MAX_ABIS || strlen(abi) >= GEN_ABI_SIZE || strchr(abi, '.') || strchr(abi, '/'))
+                    return help(argv[0]);
+
+                options.abis[options.abi_count++] = abi;
+            }
+        }
+        else if (arg[0] != '-' && !options.stem)
+            options.stem = arg;
+        else
+            return help(argv[0]);
+    }
+
+    if (!options.stem || !options.entries || !options.min_size
+            || options.min_size > options.max_size || options.max_size > LZ4_MAX_INPUT_SIZE
+            || options.compressibility < 0.0 || options.compressibility > 1.0)
+        return help(argv[0]);
+
+    if (generate(&options) < 0
+            || (options.apk && write_archive(&options, ".apk", "") < 0)
+            || (options.aab && write_archive(&options, ".aab", "base/root/") < 0))
+        return 1;
+
+    return 0;
+}
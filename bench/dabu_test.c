@@ -0,0 +1,985 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <ftw.h>
+#include <dirent.h>
+
+#include "../dabu.h"
+
+/*
+ * Behavior checks on stores written by dabu_gen. Every way of reading a
+ * store must return the same assemblies as a full decode with
+ * assemblies_dump_options(). Scratch files go next to the stores and are
+ * removed afterwards.
+ *
+ * The LZ4 compressed store and the --stored one are generated from the same
+ * seed with --extras, so both hold the same assemblies, debug symbols and
+ * .config payloads. Archives given with --archive wrap
+ * the compressed store (dabu_gen --apk/--aab), those given with --reject
+ * have a blob member that cannot be read in place. Stores given with
+ * --split are split store sets (dabu_gen --abis) of the same entry count,
+ * split over the ABIs of the preceding --abis list.
+ */
+
+int failures = 0;
+
+#define CHECK(cond, ...) \
+    do \
+    { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+            failures++; \
+        } \
+    } while (0)
+
+/*
+ * The extracted name dabu_gen's manifest gives to index i: every tenth
+ * assembly is a French satellite assembly.
+ */
+void
+expected_name(const uint32_t index, char *name, const size_t size)
+{
+    if ((index % 10) == 9)
+        snprintf(name, size, "fr_Bench.Assembly%u.resources.dll", index);
+    else
+        snprintf(name, size, "Bench.Assembly%u.dll", index);
+}
+
+/*
+ * Path of name in the directory of the store at path.
+ */
+void
+scratch_path(const char *path, const char *name, char *out, const size_t size)
+{
+    const char *slash = strrchr(path, '/');
+    const int dir_len = slash ? (int)(slash - path) + 1 : 0;
+
+    snprintf(out, size, "%.*s%s", dir_len, path, name);
+}
+
+int
+remove_path(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+void
+remove_tree(const char *path)
+{
+    nftw(path, remove_path, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/*
+ * Number of directory entries in dir besides . and .., 0 when it is missing.
+ */
+size_t
+count_files(const char *dir)
+{
+    DIR *handle = opendir(dir);
+    size_t count = 0;
+
+    if (!handle)
+        return 0;
+
+    for (struct dirent *entry = readdir(handle); entry; entry = readdir(handle))
+    {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            count++;
+    }
+
+    closedir(handle);
+    return count;
+}
+
+uint8_t*
+read_file(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    uint8_t *data = NULL;
+    if (fseek(file, 0, SEEK_END) == 0)
+    {
+        const long len = ftell(file);
+        data = (len >= 0) ? malloc((size_t)len + 1) : NULL;
+
+        if (data && (fseek(file, 0, SEEK_SET) != 0 || fread(data, 1, (size_t)len, file) != (size_t)len))
+        {
+            free(data);
+            data = NULL;
+        }
+
+        *size = (size_t)len;
+    }
+
+    fclose(file);
+    return data;
+}
+
+bool
+same_entry(const assembly_entry_T *a, const assembly_entry_T *b)
+{
+    return a->index == b->index && a->size == b->size && strcmp(a->name, b->name) == 0
+        && a->data && b->data && memcmp(a->data, b->data, a->size) == 0;
+}
+
+/*
+ * The decoded entry with the given manifest index. Tables and dabu_entry()
+ * follow the order of the store, not the index.
+ */
+const assembly_entry_T*
+reference_entry(const assembly_table_T *reference, const uint32_t index)
+{
+    for (size_t i = 0; i < reference->count; i++)
+    {
+        if (reference->entries[i].index == index)
+            return &reference->entries[i];
+    }
+
+    return NULL;
+}
+
+/*
+ * Reads every entry of an opened store and compares it with the reference.
+ */
+void
+check_store_reads(const char *path, dabu_T *store, const assembly_table_T *reference)
+{
+    CHECK(dabu_count(store) == reference->count, "%s: dabu_count() is %zu, expected %zu", path, dabu_count(store), reference->count);
+
+    for (size_t i = 0; i < dabu_count(store); i++)
+    {
+        const char *name = dabu_name(store, i);
+        const assembly_entry_T *entry = dabu_entry(store, i);
+        const assembly_entry_T *ref = entry ? reference_entry(reference, entry->index) : NULL;
+
+        CHECK(ref && strcmp(entry->name, ref->name) == 0, "%s: entry %zu has no decoded counterpart", path, i);
+        CHECK(name && entry && strcmp(name, entry->name) == 0, "%s: dabu_name() of entry %zu differs", path, i);
+        if (!ref) continue;
+
+        uint8_t *buffer = malloc(ref->size);
+        const size_t size = buffer ? dabu_read(store, i, buffer, ref->size) : 0;
+
+        CHECK(size == ref->size && memcmp(buffer, ref->data, size) == 0, "%s: dabu_read() of %s differs", path, ref->name);
+        free(buffer);
+    }
+}
+
+/*
+ * Decodes every assembly of the store, the reference for the other checks.
+ */
+size_t
+check_decode(block_T **block, const char *path, const size_t count, assembly_table_T *table, const bool compressed)
+{
+    dump_options_T options = { 0 };
+    options.jobs = 4;
+
+    const size_t decoded = assemblies_dump_options(block, path, table, &options);
+    CHECK(decoded == count, "%s: decoded %zu of %zu entries", path, decoded, count);
+
+    for (size_t i = 0; i < decoded; i++)
+    {
+        const assembly_entry_T *entry = &table->entries[i];
+        char name[256];
+        expected_name(entry->index, name, sizeof(name));
+
+        CHECK(strcmp(entry->name, name) == 0, "%s: entry %u is %s, expected %s", path, entry->index, entry->name, name);
+        CHECK(entry->compressed == compressed, "%s: %s has the wrong compressed flag", path, name);
+        CHECK(entry->data && entry->size >= 2 && memcmp(entry->data, "MZ", 2) == 0, "%s: %s is not a PE image", path, name);
+    }
+
+    return decoded;
+}
+
+void
+check_list(const char *path, const assembly_table_T *reference)
+{
+    block_T *block = NULL;
+    assembly_table_T table = { 0 };
+    dump_options_T options = { 0 };
+    options.list_only = true;
+
+    const size_t count = assemblies_dump_options(&block, path, &table, &options);
+    CHECK(count == reference->count, "%s: listed %zu of %zu entries", path, count, reference->count);
+
+    for (size_t i = 0; i < count && i < reference->count; i++)
+    {
+        const assembly_entry_T *entry = &table.entries[i];
+        const assembly_entry_T *ref = &reference->entries[i];
+
+        CHECK(entry->index == ref->index && strcmp(entry->name, ref->name) == 0 && entry->size == ref->size,
+                "%s: listed %s (%u bytes), decoded %s (%u bytes)", path, entry->name, entry->size, ref->name, ref->size);
+        CHECK(entry->data == NULL, "%s: listing read the payload of %s", path, entry->name);
+    }
+
+    block_free(&block);
+}
+
+void
+check_read(const char *path, const assembly_table_T *reference)
+{
+    dabu_T *store = dabu_open(path);
+    CHECK(store != NULL, "%s: dabu_open() failed", path);
+    if (!store) return;
+
+    check_store_reads(path, store, reference);
+    dabu_close(&store);
+}
+
+void
+check_find(const char *path, const assembly_table_T *reference)
+{
+    dabu_T *store = dabu_open(path);
+    CHECK(store != NULL, "%s: dabu_open() failed", path);
+    if (!store) return;
+
+    for (size_t i = 0; i < reference->count; i++)
+    {
+        const assembly_entry_T *ref = &reference->entries[i];
+        char stem[256];
+        snprintf(stem, sizeof(stem), "%.*s", (int)(strlen(ref->name) - 4), ref->name);
+
+        const size_t index = dabu_find(store, ref->name);
+        const assembly_entry_T *entry = (index != DABU_NOT_FOUND) ? dabu_entry(store, index) : NULL;
+
+        CHECK(entry && entry->index == ref->index, "%s: dabu_find(%s) failed", path, ref->name);
+        CHECK(dabu_find(store, stem) == index, "%s: dabu_find(%s) differs from the .dll name", path, stem);
+    }
+
+    CHECK(dabu_find(store, "Missing.Assembly.dll") == DABU_NOT_FOUND, "%s: found a missing assembly", path);
+
+    dabu_close(&store);
+}
+
+void
+check_extract(const char *path, const assembly_table_T *reference)
+{
+    uint8_t **serial = calloc(reference->count, sizeof(uint8_t*));
+    size_t *serial_sizes = calloc(reference->count, sizeof(size_t));
+    CHECK(serial && serial_sizes, "%s: calloc() failed", path);
+
+    // The second round writes from writer threads into preallocated
+    // O_DIRECT files: the unaligned tails go through the bounce buffer, or
+    // everything is written buffered where the file system refuses
+    // O_DIRECT. Either way the files must match the serial round.
+    for (int round = 0; serial && serial_sizes && round < 2; round++)
+    {
+        block_T *block = NULL;
+        assembly_table_T table = { 0 };
+        dump_options_T options = { 0 };
+        options.dump = true;
+        options.jobs = round ? 4 : 0;
+        options.writers = round ? 2 : 0;
+        options.preallocate = round;
+        options.direct_io = round;
+
+        const size_t count = assemblies_dump_options(&block, path, &table, &options);
+        CHECK(count == reference->count, "%s: round %d extracted %zu of %zu entries", path, round, count, reference->count);
+
+        for (size_t i = 0; i < reference->count; i++)
+        {
+            const assembly_entry_T *ref = &reference->entries[i];
+            char output[PATH_MAX];
+            size_t size = 0;
+
+            scratch_path(path, ref->name, output, sizeof(output));
+            uint8_t *data = read_file(output, &size);
+
+            if (round == 0)
+            {
+                CHECK(data && size == ref->size && memcmp(data, ref->data, size) == 0, "%s: extracted %s differs", path, ref->name);
+                serial[i] = data;
+                serial_sizes[i] = size;
+            }
+            else
+            {
+                CHECK(data && serial[i] && size == serial_sizes[i] && memcmp(data, serial[i], size) == 0,
+                        "%s: %s extracted by the writers differs from the serial extraction", path, ref->name);
+                free(data);
+            }
+
+            remove(output);
+        }
+
+        block_free(&block);
+    }
+
+    for (size_t i = 0; serial && i < reference->count; i++)
+        free(serial[i]);
+
+    free(serial);
+    free(serial_sizes);
+}
+
+/*
+ * A file holding size bytes equal to data, removed once read.
+ */
+bool
+same_file(const char *output, const uint8_t *data, const size_t size)
+{
+    size_t read_size = 0;
+    uint8_t *read_data = read_file(output, &read_size);
+    const bool same = read_data && data && read_size == size && memcmp(read_data, data, size) == 0;
+
+    free(read_data);
+    remove(output);
+
+    return same;
+}
+
+/*
+ * dabu_gen --extras gives every third assembly debug symbols and every fifth
+ * a .config payload naming it. The descriptors point to them whether or not
+ * they are decoded; decoded, extraction writes them as <name>.pdb and
+ * <name>.dll.config.
+ */
+void
+check_extras(const char *path, const assembly_table_T *reference)
+{
+    for (size_t i = 0; i < reference->count; i++)
+    {
+        const assembly_entry_T *ref = &reference->entries[i];
+
+        CHECK((ref->debug_data_size != 0) == ((ref->index % 3) == 0), "%s: %s has the wrong debug descriptor", path, ref->name);
+        CHECK((ref->config_data_size != 0) == ((ref->index % 5) == 0), "%s: %s has the wrong config descriptor", path, ref->name);
+        CHECK(!ref->debug && !ref->config, "%s: %s has extras that were not asked for", path, ref->name);
+    }
+
+    block_T *block = NULL;
+    assembly_table_T table = { 0 };
+    dump_options_T options = { 0 };
+    options.dump = true;
+    options.jobs = 4;
+    options.debug_data = true;
+    options.config_data = true;
+
+    const size_t count = assemblies_dump_options(&block, path, &table, &options);
+    CHECK(count == reference->count, "%s: extracted %zu of %zu entries with extras", path, count, reference->count);
+
+    for (size_t i = 0; i < count && i < reference->count; i++)
+    {
+        const assembly_entry_T *entry = &table.entries[i];
+        const bool has_debug = (entry->index % 3) == 0;
+        const bool has_config = (entry->index % 5) == 0;
+        char output[PATH_MAX];
+        char name[PATH_MAX];
+
+        const assembly_entry_T *ref = &reference->entries[i];
+
+        // Stored assemblies are copied to disk without a decoded copy, so the
+        // extracted file is compared against the reference instead.
+        CHECK(entry->index == ref->index && entry->size == ref->size && strcmp(entry->name, ref->name) == 0
+                && (!entry->data || memcmp(entry->data, ref->data, ref->size) == 0),
+              "%s: %s differs when decoded with extras", path, entry->name);
+        CHECK((entry->debug != NULL) == has_debug, "%s: %s has the wrong debug pointer", path, entry->name);
+        CHECK((entry->config != NULL) == has_config, "%s: %s has the wrong config pointer", path, entry->name);
+
+        if (entry->debug)
+        {
+            CHECK(entry->debug_size > 4 && memcmp(entry->debug, "BSJB", 4) == 0, "%s: the debug symbols of %s are not a PDB", path, entry->name);
+
+            snprintf(name, sizeof(name), "%.*s.pdb", (int)(strrchr(entry->name, '.') - entry->name), entry->name);
+            scratch_path(path, name, output, sizeof(output));
+            CHECK(same_file(output, entry->debug, entry->debug_size), "%s: extracted %s differs", path, name);
+        }
+
+        if (entry->config)
+        {
+            char text[1024];
+            snprintf(text, sizeof(text), "%.*s", (int)entry->config_size, (const char*)entry->config);
+            snprintf(name, sizeof(name), "%.*s", (int)(strrchr(entry->name, '.') - entry->name), entry->name);
+            CHECK(strstr(text, "<configuration>") && strstr(text, name), "%s: the config payload of %s does not name it", path, entry->name);
+
+            snprintf(name, sizeof(name), "%s.config", entry->name);
+            scratch_path(path, name, output, sizeof(output));
+            CHECK(same_file(output, entry->config, entry->config_size), "%s: extracted %s differs", path, name);
+        }
+
+        scratch_path(path, entry->name, output, sizeof(output));
+        CHECK(same_file(output, ref->data, ref->size), "%s: extracted %s differs", path, entry->name);
+    }
+
+    block_free(&block);
+}
+
+void
+check_tar(const char *path, const assembly_table_T *reference)
+{
+    block_T *block = NULL;
+    assembly_table_T table = { 0 };
+    dump_options_T options = { 0 };
+    char archive[PATH_MAX];
+
+    scratch_path(path, "dabu_test.tar", archive, sizeof(archive));
+    options.archive = archive;
+
+    const size_t count = assemblies_dump_options(&block, path, &table, &options);
+    CHECK(count == reference->count, "%s: archived %zu of %zu entries", path, count, reference->count);
+    block_free(&block);
+
+    size_t size = 0;
+    uint8_t *tar = read_file(archive, &size);
+    CHECK(tar && (size % 512) == 0, "%s: %s is not a tar archive", path, archive);
+
+    // Members are in index order: a ustar header, then the data padded to 512 bytes.
+    size_t pos = 0;
+    for (size_t i = 0; tar && i < reference->count; i++)
+    {
+        const assembly_entry_T *ref = &reference->entries[i];
+        if (pos + 512 > size)
+        {
+            CHECK(false, "%s: archive ends before %s", path, ref->name);
+            break;
+        }
+
+        const char *header = (const char*)tar + pos;
+        const size_t member_size = (size_t)strtoull(header + 124, NULL, 8);
+
+        CHECK(strncmp(header, ref->name, 100) == 0, "%s: archive member %.100s, expected %s", path, header, ref->name);
+        CHECK(memcmp(header + 257, "ustar", 5) == 0, "%s: member %s has no ustar magic", path, ref->name);
+        CHECK(member_size == ref->size && pos + 512 + member_size <= size
+                && memcmp(tar + pos + 512, ref->data, ref->size) == 0, "%s: archived %s differs", path, ref->name);
+
+        pos += 512 + ((member_size + 511) & ~(size_t)511);
+    }
+
+    // Two zero blocks end the archive.
+    CHECK(tar && pos + 1024 <= size && tar[pos] == 0 && tar[pos + 512] == 0, "%s: archive has no end of archive marker", path);
+
+    free(tar);
+    remove(archive);
+}
+
+void
+check_cache(const char *path, const assembly_table_T *reference)
+{
+    char cache[PATH_MAX];
+    scratch_path(path, "dabu_test.cache", cache, sizeof(cache));
+    remove_tree(cache);
+
+    // A handle resolves entries as they are used and caches only those, a
+    // later handle resolves the rest from the blob.
+    dabu_T *store = dabu_open_cached(path, cache);
+    CHECK(store != NULL, "%s: dabu_open_cached() failed", path);
+    dabu_close(&store);
+    CHECK(count_files(cache) == 0, "%s: a handle that resolved nothing wrote a cache file", path);
+
+    store = dabu_open_cached(path, cache);
+    CHECK(store && dabu_entry(store, 0), "%s: dabu_open_cached() failed", path);
+    dabu_close(&store);
+    CHECK(count_files(cache) == 1, "%s: a handle did not cache the entry it resolved", path);
+
+    store = dabu_open_cached(path, cache);
+    if (store)
+        check_store_reads(path, store, reference);
+
+    dabu_close(&store);
+    remove_tree(cache);
+
+    for (int round = 0; round < 2; round++)
+    {
+        block_T *block = NULL;
+        assembly_table_T table = { 0 };
+        dump_stats_T stats = { 0 };
+        dump_options_T options = { 0 };
+        options.cache = cache;
+        options.cache_data = true;
+        options.stats = &stats;
+
+        const size_t count = assemblies_dump_options(&block, path, &table, &options);
+        const size_t expected = round ? reference->count : 0;
+
+        CHECK(count == reference->count, "%s: round %d decoded %zu of %zu entries", path, round, count, reference->count);
+        CHECK(stats.cached == expected, "%s: round %d read %zu entries from the cache, expected %zu", path, round, stats.cached, expected);
+
+        for (size_t i = 0; i < count && i < reference->count; i++)
+            CHECK(same_entry(&table.entries[i], &reference->entries[i]), "%s: round %d decoded %s differently", path, round, table.entries[i].name);
+
+        block_free(&block);
+    }
+
+    store = dabu_open_cached(path, cache);
+    CHECK(store != NULL, "%s: dabu_open_cached() failed", path);
+
+    if (store)
+        check_store_reads(path, store, reference);
+
+    dabu_close(&store);
+    remove_tree(cache);
+}
+
+void
+check_cas(const char *path, const assembly_table_T *reference)
+{
+    char cas[PATH_MAX];
+    scratch_path(path, "dabu_test.cas", cas, sizeof(cas));
+    remove_tree(cas);
+
+    // The second pass finds every assembly in the store already.
+    for (int round = 0; round < 2; round++)
+    {
+        block_T *block = NULL;
+        assembly_table_T table = { 0 };
+        dump_stats_T stats = { 0 };
+        dump_options_T options = { 0 };
+        options.cas = cas;
+        options.stats = &stats;
+
+        const size_t count = assemblies_dump_options(&block, path, &table, &options);
+        const size_t expected = round ? reference->count : 0;
+
+        CHECK(count == reference->count, "%s: stored %zu of %zu entries", path, count, reference->count);
+        CHECK(stats.deduplicated == expected, "%s: round %d deduplicated %zu entries, expected %zu", path, round, stats.deduplicated, expected);
+
+        for (size_t i = 0; i < count && i < reference->count; i++)
+        {
+            const assembly_entry_T *entry = &table.entries[i];
+            const assembly_entry_T *ref = &reference->entries[i];
+            char object[PATH_MAX];
+            size_t size = 0;
+
+            CHECK(entry->object != NULL, "%s: %s has no object", path, entry->name);
+            if (!entry->object || snprintf(object, sizeof(object), "%s/%s", cas, entry->object) >= (int)sizeof(object))
+                continue;
+
+            uint8_t *data = read_file(object, &size);
+
+            CHECK(data && size == ref->size && memcmp(data, ref->data, size) == 0, "%s: object of %s differs", path, ref->name);
+            free(data);
+        }
+
+        block_free(&block);
+    }
+
+    remove_tree(cas);
+}
+
+void
+check_filters(const char *path, const assembly_table_T *reference)
+{
+    static const char *const satellites[] = { "fr_*", NULL };
+    static const char *const first_ten[] = { "re:^Bench\\.Assembly[0-9]\\.dll$", NULL };
+
+    size_t satellite_count = 0;
+    size_t first_ten_count = 0;
+    for (size_t i = 0; i < reference->count; i++)
+    {
+        satellite_count += (strncmp(reference->entries[i].name, "fr_", 3) == 0);
+        first_ten_count += (reference->entries[i].index < 10 && (reference->entries[i].index % 10) != 9);
+    }
+
+    struct {
+        const char *const *include;
+        const char *const *exclude;
+        size_t expected;
+    } cases[] = {
+        { satellites, NULL, satellite_count },
+        { NULL, satellites, reference->count - satellite_count },
+        { first_ten, NULL, first_ten_count },
+    };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        block_T *block = NULL;
+        assembly_table_T table = { 0 };
+        dump_options_T options = { 0 };
+        options.include = cases[c].include;
+        options.exclude = cases[c].exclude;
+
+        const size_t count = assemblies_dump_options(&block, path, &table, &options);
+        CHECK(count == cases[c].expected, "%s: filter %zu kept %zu entries, expected %zu", path, c, count, cases[c].expected);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const assembly_entry_T *entry = &table.entries[i];
+            const bool satellite = strncmp(entry->name, "fr_", 3) == 0;
+            const bool wanted = (c == 0) ? satellite : (c == 1) ? !satellite : (entry->index < 10 && !satellite);
+
+            CHECK(wanted, "%s: filter %zu kept %s", path, c, entry->name);
+            const assembly_entry_T *ref = reference_entry(reference, entry->index);
+            CHECK(ref && same_entry(entry, ref), "%s: filtered %s differs", path, entry->name);
+        }
+
+        block_free(&block);
+    }
+}
+
+/*
+ * An APK/AAB reads the same assemblies in place as the blob it wraps, and
+ * has the same fingerprint: it uses the cache file the blob wrote.
+ */
+void
+check_archive(const char *path, const char *blob, const assembly_table_T *reference)
+{
+    block_T *block = NULL;
+    assembly_table_T table = { 0 };
+    dump_options_T options = { 0 };
+
+    const size_t count = assemblies_dump_options(&block, path, &table, &options);
+    CHECK(count == reference->count, "%s: decoded %zu of %zu entries", path, count, reference->count);
+
+    for (size_t i = 0; i < count && i < reference->count; i++)
+        CHECK(same_entry(&table.entries[i], &reference->entries[i]), "%s: %s differs from the blob", path, reference->entries[i].name);
+
+    block_free(&block);
+
+    check_read(path, reference);
+    check_find(path, reference);
+    check_extract(path, reference);
+
+    char cache[PATH_MAX];
+    scratch_path(path, "dabu_test.cache", cache, sizeof(cache));
+    remove_tree(cache);
+
+    const char *sources[2] = { blob, path };
+    for (int round = 0; round < 2; round++)
+    {
+        dump_stats_T stats = { 0 };
+        memset(&options, 0, sizeof(options));
+        options.cache = cache;
+        options.cache_data = true;
+        options.stats = &stats;
+
+        block = NULL;
+        assemblies_dump_options(&block, sources[round], &table, &options);
+
+        const size_t expected = round ? reference->count : 0;
+        CHECK(stats.cached == expected, "%s: read %zu entries from the cache, expected %zu", sources[round], stats.cached, expected);
+        block_free(&block);
+    }
+
+    remove_tree(cache);
+}
+
+#define TEST_MAX_ABIS 8
+
+typedef struct {
+    char list[256];
+    const char *names[TEST_MAX_ABIS];
+    size_t count;
+} abi_list_T;
+
+void
+abi_list_parse(abi_list_T *abis, const char *list)
+{
+    memset(abis, 0, sizeof(abi_list_T));
+    snprintf(abis->list, sizeof(abis->list), "%s", list);
+
+    for (char *abi = strtok(abis->list, ","); abi && abis->count < TEST_MAX_ABIS; abi = strtok(NULL, ","))
+        abis->names[abis->count++] = abi;
+}
+
+/*
+ * Position of abi in the list, abis->count when it is not in it.
+ */
+size_t
+abi_position(const abi_list_T *abis, const char *abi)
+{
+    for (size_t a = 0; abi && a < abis->count; a++)
+    {
+        if (strcmp(abis->names[a], abi) == 0)
+            return a;
+    }
+
+    return abis->count;
+}
+
+/*
+ * dabu_gen keeps every fourth assembly that is not a satellite one in the
+ * per-ABI stores.
+ */
+bool
+is_per_abi(const uint32_t index)
+{
+    return (index % 4) == 3 && (index % 10) != 9;
+}
+
+/*
+ * The index dabu_gen numbered an assembly with, from its name.
+ */
+uint32_t
+name_index(const char *name)
+{
+    unsigned int index = UINT32_MAX;
+
+    if (strncmp(name, "fr_", 3) == 0)
+        name += 3;
+
+    return sscanf(name, "Bench.Assembly%u", &index) == 1 ? index : UINT32_MAX;
+}
+
+typedef struct {
+    size_t blobs;
+    size_t expected;
+} batch_T;
+
+void
+count_batch_blob(const char *path, const assembly_table_T *table, void *ctx)
+{
+    batch_T *batch = ctx;
+    batch->blobs++;
+
+    CHECK(table->count == batch->expected, "%s: batch read %zu of %zu entries", path, table->count, batch->expected);
+}
+
+/*
+ * A split store set, read on disk or from an APK: the primary store holds
+ * the shared assemblies, the per-ABI stores next to it a copy of each of
+ * the others, stamped with their ABI. Every copy has store_id and abi set,
+ * and extraction writes it below <abi>/. first, when given, is the table of
+ * the same set read another way.
+ */
+void
+check_split(const char *path, const abi_list_T *abis, const size_t count, block_T **block, assembly_table_T *table, const assembly_table_T *first)
+{
+    dump_options_T options = { 0 };
+    options.jobs = 4;
+
+    size_t per_abi = 0;
+    for (uint32_t i = 0; i < count; i++)
+        per_abi += is_per_abi(i);
+
+    const size_t expected = count + (per_abi * (abis->count - 1));
+    const size_t decoded = assemblies_dump_options(block, path, table, &options);
+    CHECK(decoded == expected, "%s: decoded %zu of %zu entries", path, decoded, expected);
+
+    // One bit per ABI for each per-ABI assembly, bit 0 for a shared one.
+    uint32_t *seen = calloc(count, sizeof(uint32_t));
+    CHECK(seen != NULL, "%s: calloc() failed", path);
+
+    for (size_t i = 0; seen && i < decoded; i++)
+    {
+        const assembly_entry_T *entry = &table->entries[i];
+        const uint32_t index = name_index(entry->name);
+        const size_t abi = abi_position(abis, entry->abi);
+
+        CHECK(index < count, "%s: unexpected entry %s", path, entry->name);
+        if (index >= count) continue;
+
+        if (is_per_abi(index))
+        {
+            CHECK(entry->store_id == 1 && abi < abis->count, "%s: %s is not in a per-ABI store", path, entry->name);
+            CHECK(abi == abis->count || (entry->size > 2 && memcmp(entry->data + 2, entry->abi, strlen(entry->abi)) == 0),
+                    "%s: %s/%s does not hold its ABI's copy", path, entry->abi, entry->name);
+
+            if (abi == abis->count) continue;
+
+            CHECK(!(seen[index] & (1u << abi)), "%s: %s/%s is listed twice", path, entry->abi, entry->name);
+            seen[index] |= 1u << abi;
+        }
+        else
+        {
+            CHECK(entry->store_id == 0 && entry->abi == NULL, "%s: %s is not in the primary store", path, entry->name);
+            CHECK(!seen[index], "%s: %s is listed twice", path, entry->name);
+            seen[index] = 1;
+        }
+    }
+
+    for (uint32_t i = 0; seen && i < count; i++)
+    {
+        const uint32_t all = is_per_abi(i) ? (uint32_t)((1u << abis->count) - 1) : 1;
+        CHECK(seen[i] == all, "%s: assembly %u is missing from some stores", path, i);
+    }
+
+    free(seen);
+
+    for (size_t i = 0; first && i < decoded && i < first->count; i++)
+    {
+        const assembly_entry_T *entry = &table->entries[i];
+        const assembly_entry_T *ref = &first->entries[i];
+
+        CHECK(same_entry(entry, ref) && entry->store_id == ref->store_id && abi_position(abis, entry->abi) == abi_position(abis, ref->abi),
+                "%s: %s differs from the store set on disk", path, ref->name);
+    }
+
+    // Handles hold the same entries in the same order.
+    dabu_T *store = dabu_open(path);
+    CHECK(store && dabu_count(store) == decoded, "%s: dabu_open() does not hold the %zu entries", path, decoded);
+
+    for (size_t i = 0; store && i < dabu_count(store) && i < decoded; i++)
+    {
+        const assembly_entry_T *entry = dabu_entry(store, i);
+        const assembly_entry_T *ref = &table->entries[i];
+        uint8_t *buffer = malloc(ref->size);
+        const size_t size = (entry && buffer) ? dabu_read(store, i, buffer, ref->size) : 0;
+
+        CHECK(entry && strcmp(entry->name, ref->name) == 0 && entry->store_id == ref->store_id
+                && abi_position(abis, entry->abi) == abi_position(abis, ref->abi),
+                "%s: handle entry %zu differs from %s", path, i, ref->name);
+        CHECK(size == ref->size && memcmp(buffer, ref->data, size) == 0, "%s: dabu_read() of %s differs", path, ref->name);
+        free(buffer);
+    }
+
+    dabu_close(&store);
+
+    // Per-ABI copies are extracted below <abi>/.
+    block_T *dump_block = NULL;
+    assembly_table_T dumped = { 0 };
+    options.dump = true;
+    assemblies_dump_options(&dump_block, path, &dumped, &options);
+    block_free(&dump_block);
+
+    for (size_t i = 0; i < decoded; i++)
+    {
+        const assembly_entry_T *entry = &table->entries[i];
+        char name[PATH_MAX];
+        char output[PATH_MAX];
+        size_t size = 0;
+
+        snprintf(name, sizeof(name), "%s%s%s", entry->abi ? entry->abi : "", entry->abi ? "/" : "", entry->name);
+        scratch_path(path, name, output, sizeof(output));
+        uint8_t *data = read_file(output, &size);
+
+        CHECK(data && size == entry->size && memcmp(data, entry->data, size) == 0, "%s: extracted %s differs", path, name);
+        free(data);
+        remove(output);
+    }
+
+    for (size_t a = 0; a < abis->count; a++)
+    {
+        char output[PATH_MAX];
+        scratch_path(path, abis->names[a], output, sizeof(output));
+        remove_tree(output);
+    }
+
+    // A batch over the directory of the set reads the per-ABI stores with
+    // their primary store only, the APK next to it on its own.
+    if (!first)
+    {
+        const char *slash = strrchr(path, '/');
+        char dir[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%.*s", slash ? (int)(slash - path) : 1, slash ? path : ".");
+
+        batch_T batch = { 0, expected };
+        dump_options_T batch_options = { 0 };
+        batch_options.list_only = true;
+
+        const size_t blobs = dabu_dump_many(dir, &batch_options, count_batch_blob, &batch);
+        CHECK(blobs == batch.blobs && blobs >= 1, "%s: batch read %zu blobs, reported %zu", dir, blobs, batch.blobs);
+    }
+}
+
+void
+check_rejected(const char *path)
+{
+    block_T *block = NULL;
+    assembly_table_T table = { 0 };
+    dump_options_T options = { 0 };
+
+    dabu_T *store = dabu_open(path);
+    CHECK(store == NULL, "%s: dabu_open() accepted a compressed blob member", path);
+    dabu_close(&store);
+
+    CHECK(assemblies_dump_options(&block, path, &table, &options) == 0, "%s: decoded a compressed blob member", path);
+    block_free(&block);
+}
+
+int
+help(const char *prog)
+{
+    fprintf(stderr, "%s <entry count> <compressed blob> <stored blob> [--archive A]... [--reject A]...\n", prog);
+    fprintf(stderr, "    [--abis LIST --split S...]...\n");
+    return 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 4 || (argc % 2) != 0)
+        return help(argv[0]);
+
+    for (int i = 4; i < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--archive") != 0 && strcmp(argv[i], "--reject") != 0
+                && strcmp(argv[i], "--abis") != 0 && strcmp(argv[i], "--split") != 0)
+            return help(argv[0]);
+    }
+
+    const size_t count = (size_t)strtoul(argv[1], NULL, 10);
+    const char *paths[2] = { argv[2], argv[3] };
+    assembly_table_T tables[2] = { 0 };
+    block_T *blocks[2] = { NULL, NULL };
+
+    if (!count)
+        return help(argv[0]);
+
+    for (size_t s = 0; s < sizeof(paths) / sizeof(paths[0]); s++)
+    {
+        if (check_decode(&blocks[s], paths[s], count, &tables[s], s == 0) != count)
+            continue;
+
+        check_list(paths[s], &tables[s]);
+        check_read(paths[s], &tables[s]);
+        check_filters(paths[s], &tables[s]);
+        check_find(paths[s], &tables[s]);
+        check_extract(paths[s], &tables[s]);
+        check_extras(paths[s], &tables[s]);
+        check_tar(paths[s], &tables[s]);
+        check_cas(paths[s], &tables[s]);
+        check_cache(paths[s], &tables[s]);
+    }
+
+    // Generated from the same seed, both stores hold the same assemblies.
+    for (size_t i = 0; tables[0].count == count && tables[1].count == count && i < count; i++)
+        CHECK(same_entry(&tables[0].entries[i], &tables[1].entries[i]), "%s differs between the compressed and stored blobs", tables[0].entries[i].name);
+
+    for (int i = 4; tables[0].count == count && i < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--archive") == 0)
+            check_archive(argv[i + 1], paths[0], &tables[0]);
+        else if (strcmp(argv[i], "--reject") == 0)
+            check_rejected(argv[i + 1]);
+    }
+
+    // Each split store set is compared with the first store of its --abis.
+    abi_list_T abis = { 0 };
+    block_T *split_blocks[2] = { NULL, NULL };
+    assembly_table_T split_tables[2] = { 0 };
+    size_t splits = 0;
+
+    for (int i = 4; i < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--abis") == 0)
+        {
+            abi_list_parse(&abis, argv[i + 1]);
+            block_free(&split_blocks[0]);
+            splits = 0;
+        }
+        else if (strcmp(argv[i], "--split") == 0)
+        {
+            CHECK(abis.count > 1, "%s: --split needs an --abis list of two ABIs or more", argv[i + 1]);
+            if (abis.count < 2) continue;
+
+            const size_t s = splits ? 1 : 0;
+            block_free(&split_blocks[s]);
+            memset(&split_tables[s], 0, sizeof(assembly_table_T));
+
+            check_split(argv[i + 1], &abis, count, &split_blocks[s], &split_tables[s], s ? &split_tables[0] : NULL);
+            splits++;
+        }
+    }
+
+    block_free(&split_blocks[0]);
+    block_free(&split_blocks[1]);
+
+    for (size_t s = 0; s < sizeof(paths) / sizeof(paths[0]); s++)
+        block_free(&blocks[s]);
+
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    else
+        printf("all checks passed on %zu entries\n", count);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+// The point is to compare against the deprecated decoder.
+#define LZ4_DISABLE_DEPRECATE_WARNINGS
+#include "../lz4.h"
+
+#include "../dabu.h"
+
+#define XALZ_HEADER_SIZE 12
+
+/*
+ * Decodes every XALZ payload of the given blobs with LZ4_decompress_fast()
+ * and LZ4_decompress_safe() and reports the throughput of both, so the bounds
+ * checked decoder used by the library can be compared on real blobs. Only
+ * the payloads of the blob file itself are decoded: APK/AAB input is
+ * rejected and entries of the per-ABI stores next to it are skipped.
+ */
+
+double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
+
+uint8_t *
+read_all(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t *buffer = (len > 0) ? malloc((size_t)len) : NULL;
+    if (!buffer || fread(buffer, (size_t)len, 1, file) != 1)
+    {
+        free(buffer);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    *size = (size_t)len;
+
+    return buffer;
+}
+
+int
+bench_blob(const char *path, const int rounds)
+{
+    assembly_table_T table = { 0 };
+    block_T *block = NULL;
+
+    size_t count = assemblies_dump_table(&block, path, &table, false);
+
+    size_t blob_size = 0;
+    uint8_t *blob = read_all(path, &blob_size);
+
+    if (!count || !blob)
+    {
+        fprintf(stderr, "failed loading %s\n", path);
+        free(blob);
+        block_free(&block);
+        return -1;
+    }
+
+    // Payload offsets are relative to the blob member, not to the archive.
+    if (blob_size >= 4 && memcmp(blob, "PK\x03\x04", 4) == 0)
+    {
+        fprintf(stderr, "%s: APK/AAB input is not supported, pass the extracted assemblies.blob\n", path);
+        free(blob);
+        block_free(&block);
+        return -1;
+    }
+
+    // Stored assemblies have nothing to decompress, per-ABI entries live in
+    // another file.
+    bool *skip = calloc(count ? count : 1, sizeof(bool));
+    if (!skip)
+    {
+        free(blob);
+        block_free(&block);
+        return -1;
+    }
+
+    size_t max_size = 0;
+    size_t total = 0;
+    size_t decoded = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const assembly_entry_T *entry = &table.entries[i];
+
+        skip[i] = !entry->compressed || entry->abi || entry->data_size <= XALZ_HEADER_SIZE
+            || (uint64_t)entry->data_offset + entry->data_size > blob_size;
+        if (skip[i]) continue;
+
+        if (entry->size > max_size) max_size = entry->size;
+        total += entry->size;
+        decoded++;
+    }
+
+    char *out = malloc(max_size ? max_size : 1);
+    if (!out)
+    {
+        free(skip);
+        free(blob);
+        block_free(&block);
+        return -1;
+    }
+
+    double elapsed[2] = { 0 };
+    int errors = 0;
+
+    // Warm the page cache and the output buffer before timing anything.
+    for (size_t i = 0; i < count; i++)
+    {
+        const assembly_entry_T *entry = &table.entries[i];
+        if (skip[i]) continue;
+
+        LZ4_decompress_safe((const char*)blob + entry->data_offset + XALZ_HEADER_SIZE, out,
+                (int)(entry->data_size - XALZ_HEADER_SIZE), (int)entry->size);
+    }
+
+    for (int mode = 0; mode < 2; mode++)
+    {
+        const double start = now();
+
+        for (int r = 0; r < rounds; r++)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                const assembly_entry_T *entry = &table.entries[i];
+                if (skip[i]) continue;
+
+                const char *src = (const char*)blob + entry->data_offset + XALZ_HEADER_SIZE;
+                const int src_size = (int)(entry->data_size - XALZ_HEADER_SIZE);
+
+                int ret = (mode == 0)
+                    ? LZ4_decompress_fast(src, out, (int)entry->size)
+                    : LZ4_decompress_safe(src, out, src_size, (int)entry->size);
+
+                if (ret < 0) errors++;
+            }
+        }
+
+        elapsed[mode] = now() - start;
+    }
+
+    const double mb = ((double)total * rounds) / (1024.0 * 1024.0);
+    printf("%s: %zu of %zu entries, %.1f MiB decompressed x %d\n", path, decoded, count, (double)total / (1024.0 * 1024.0), rounds);
+    printf("  LZ4_decompress_fast: %8.1f MB/s\n", mb / elapsed[0]);
+    printf("  LZ4_decompress_safe: %8.1f MB/s (%.1f%%)\n", mb / elapsed[1], (elapsed[0] / elapsed[1]) * 100.0);
+
+    if (errors)
+        fprintf(stderr, "  %d decode errors\n", errors);
+
+    free(out);
+    free(skip);
+    free(blob);
+    block_free(&block);
+
+    return errors ? -1 : 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int rounds = 10;
+    int first = 1;
+
+    if (argc >= 3 && strcmp(argv[1], "-n") == 0)
+    {
+        rounds = atoi(argv[2]);
+        first = 3;
+    }
+
+    if (first >= argc || rounds <= 0)
+    {
+        fprintf(stderr, "%s [-n rounds] <blob file>...\n", argv[0]);
+        fprintf(stderr, "  decodes the compressed payloads of each assemblies.blob file; APK/AAB\n");
+        fprintf(stderr, "  input is rejected and per-ABI store entries are skipped\n");
+        return -1;
+    }
+
+    int ret = 0;
+    for (int i = first; i < argc; i++)
+    {
+        if (bench_blob(argv[i], rounds) < 0)
+            ret = -1;
+    }
+
+    return ret;
+}
@@ -1,14 +1,261 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdarg.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include "../dabu.h"
 
+#define OUT_BUFFER_SIZE (64 * 1024)
+
+typedef enum {
+    FORMAT_PLAIN,
+    FORMAT_NDJSON,
+    FORMAT_JSON,
+    FORMAT_TSV
+} format_T;
+
+/*
+ * Buffered stdout writer, records are appended to the buffer and flushed in
+ * large writes instead of one stdio call per line.
+ */
+typedef struct {
+    char buffer[OUT_BUFFER_SIZE];
+    size_t len;
+    FILE *file;
+} out_T;
+
+typedef struct {
+    out_T *out;
+    format_T format;
+    size_t records;
+    const char *blob;
+    // Blobs of a batch handed to emit_blob(), read or not.
+    size_t blobs;
+} emit_T;
+
+void
+out_flush(out_T *out)
+{
+    if (out->len)
+    {
+        fwrite(out->buffer, 1, out->len, out->file);
+        out->len = 0;
+    }
+}
+
+void
+out_write(out_T *out, const char *data, const size_t len)
+{
+    if ((out->len + len) > sizeof(out->buffer))
+        out_flush(out);
+
+    if (len > sizeof(out->buffer))
+    {
+        fwrite(data, 1, len, out->file);
+        return;
+    }
+
+    memcpy(out->buffer + out->len, data, len);
+    out->len += len;
+}
+
+void
+out_printf(out_T *out, const char *fmt, ...)
+{
+    char line[1024];
+    va_list args;
+    va_list again;
+
+    va_start(args, fmt);
+    va_copy(again, args);
+    const int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    // Records longer than the line buffer are formatted on the heap.
+    if (len >= 0 && (size_t)len >= sizeof(line))
+    {
+        char *record = malloc((size_t)len + 1);
+        if (record && vsnprintf(record, (size_t)len + 1, fmt, again) == len)
+            out_write(out, record, (size_t)len);
+        else
+            fprintf(stderr, "failed formatting a %d byte record\n", len);
+
+        free(record);
+    }
+    else if (len >= 0)
+        out_write(out, line, (size_t)len);
+
+    va_end(again);
+}
+
+void
+out_json_string(out_T *out, const char *text)
+{
+    out_write(out, "\"", 1);
+
+    for (const char *iter = text; *iter; iter++)
+    {
+        const unsigned char c = (unsigned char)*iter;
+
+        if (c == '"' || c == '\\')
+        {
+            char escaped[2] = { '\\', (char)c };
+            out_write(out, escaped, 2);
+        }
+        else if (c < 0x20)
+            out_printf(out, "\\u%04x", c);
+        else
+            out_write(out, iter, 1);
+    }
+
+    out_write(out, "\"", 1);
+}
+
+void
+emit_json_record(out_T *out, const char *blob, const assembly_entry_T *entry)
+{
+    if (blob)
+    {
+        out_write(out, "{\"blob\":", 8);
+        out_json_string(out, blob);
+        out_write(out, ",\"name\":", 8);
+    }
+    else
+        out_write(out, "{\"name\":", 8);
+
+    out_json_string(out, entry->name);
+    out_printf(out,
+            ",\"hash32\":\"0x%08" PRIx32 "\",\"hash64\":\"0x%016" PRIx64 "\",\"index\":%" PRIu32
+            ",\"data_offset\":%" PRIu32 ",\"compressed_size\":%" PRIu32 ",\"size\":%" PRIu32 ",\"store_id\":%" PRIu32
+            ",\"debug_data_offset\":%" PRIu32 ",\"debug_data_size\":%" PRIu32
+            ",\"config_data_offset\":%" PRIu32 ",\"config_data_size\":%" PRIu32,
+            entry->hash32, entry->hash64, entry->index, entry->data_offset, entry->data_size, entry->size, entry->store_id,
+            entry->debug_data_offset, entry->debug_data_size, entry->config_data_offset, entry->config_data_size);
+
+    if (entry->abi)
+    {
+        out_write(out, ",\"abi\":", 7);
+        out_json_string(out, entry->abi);
+    }
+
+    if (entry->object)
+    {
+        out_write(out, ",\"object\":", 10);
+        out_json_string(out, entry->object);
+    }
+
+    out_write(out, "}", 1);
+}
+
+void
+emit_entry(const assembly_entry_T *entry, void *ctx)
+{
+    emit_T *emit = ctx;
+    out_T *out = emit->out;
+
+    if (!entry->name[0])
+        return;
+
+    switch (emit->format)
+    {
+        case FORMAT_PLAIN:
+            if (emit->blob) out_printf(out, "%s\t", emit->blob);
+            if (entry->abi) out_printf(out, "%s/", entry->abi);
+            out_write(out, entry->name, entry->name_len);
+            out_write(out, "\n", 1);
+            break;
+        case FORMAT_NDJSON:
+            emit_json_record(out, emit->blob, entry);
+            out_write(out, "\n", 1);
+            break;
+        case FORMAT_JSON:
+            out_write(out, (emit->records) ? ",\n" : "\n", (emit->records) ? 2 : 1);
+            emit_json_record(out, emit->blob, entry);
+            break;
+        case FORMAT_TSV:
+            if (emit->blob) out_printf(out, "%s\t", emit->blob);
+            out_printf(out, "%s\t0x%08" PRIx32 "\t0x%016" PRIx64 "\t%" PRIu32 "\t%" PRIu32 "\t%" PRIu32 "\t%" PRIu32 "\t%" PRIu32
+                    "\t%s\t%" PRIu32 "\t%" PRIu32 "\t%" PRIu32 "\t%" PRIu32 "\t%s\n",
+                    entry->name, entry->hash32, entry->hash64, entry->index, entry->data_offset, entry->data_size, entry->size,
+                    entry->store_id, entry->abi ? entry->abi : "", entry->debug_data_offset, entry->debug_data_size,
+                    entry->config_data_offset, entry->config_data_size, entry->object ? entry->object : "");
+            break;
+    }
+
+    emit->records++;
+}
+
+void
+emit_blob(const char *path, const assembly_table_T *table, void *ctx)
+{
+    emit_T *emit = ctx;
+    emit->blob = path;
+
+    emit->blobs++;
+
+    for (size_t i = 0; i < table->count; i++)
+        emit_entry(&table->entries[i], emit);
+
+    emit->blob = NULL;
+}
+
+void
+print_stats(const dump_stats_T *stats)
+{
+    fprintf(stderr, "entries:  %zu listed, %zu decoded, %zu failed, %zu filtered out, %zu deduplicated, %zu cached, %zu in index\n",
+            stats->listed, stats->decoded, stats->failed, stats->skipped, stats->deduplicated, stats->cached, stats->entries);
+    fprintf(stderr, "bytes:    %" PRIu64 " in, %" PRIu64 " out, %" PRIu64 " written\n",
+            stats->bytes_in, stats->bytes_out, stats->bytes_written);
+    fprintf(stderr, "arena:    %zu bytes high-water\n", stats->arena_peak);
+    fprintf(stderr, "time ms:  tables %.3f, manifest %.3f, payload io %.3f, lz4 %.3f, write %.3f, total %.3f\n",
+            stats->table_seconds * 1e3, stats->manifest_seconds * 1e3, stats->io_seconds * 1e3,
+            stats->decode_seconds * 1e3, stats->write_seconds * 1e3, stats->total_seconds * 1e3);
+}
+
+int
+parse_format(const char *text, format_T *format)
+{
+    if (strcmp(text, "plain") == 0) *format = FORMAT_PLAIN;
+    else if (strcmp(text, "ndjson") == 0) *format = FORMAT_NDJSON;
+    else if (strcmp(text, "json") == 0) *format = FORMAT_JSON;
+    else if (strcmp(text, "tsv") == 0) *format = FORMAT_TSV;
+    else return -1;
+
+    return 0;
+}
+
 int
 help(const char* prog)
 {
-    fprintf(stderr, "%s <blob file>\n", prog);
+    fprintf(stderr, "%s [--jobs N] [--format=plain|ndjson|json|tsv] [--include P] [--exclude P] [--extract] <blob file>\n", prog);
+    fprintf(stderr, "%s [--jobs N] [--format=...] --batch <dir|list file>\n", prog);
+    fprintf(stderr, "  --jobs N    decompress with N threads, or process N blobs at once with --batch\n");
+    fprintf(stderr, "  --format F  output one record per assembly: name, hashes, store index,\n");
+    fprintf(stderr, "              data offset, compressed and uncompressed size, store id, ABI and\n");
+    fprintf(stderr, "              the offsets and sizes of the debug and config payloads\n");
+    fprintf(stderr, "  --batch S   process every *.blob, *.apk and *.aab below directory S, or\n");
+    fprintf(stderr, "              every path listed in file S, in one process\n");
+    fprintf(stderr, "  --stats     print per-phase timings and counters to stderr\n");
+    fprintf(stderr, "  --extract   write every assembly next to the blob\n");
+    fprintf(stderr, "  --writers N with --extract, write files from N threads while decompressing\n");
+    fprintf(stderr, "  --preallocate  with --extract, fallocate() output files before writing\n");
+    fprintf(stderr, "  --direct    with --extract, write output files with O_DIRECT\n");
+    fprintf(stderr, "  --tar F     write every assembly into the tar archive F, - for stdout\n");
+    fprintf(stderr, "  --cas D     store every assembly once in the content addressed directory D,\n");
+    fprintf(stderr, "              records carry its object path, --extract files are copied from it\n");
+    fprintf(stderr, "  --sha256    with --cas, key objects by SHA-256 instead of xxh64\n");
+    fprintf(stderr, "  --cas-link  with --cas and --extract, hard link files to the objects; editing\n");
+    fprintf(stderr, "              one in place then changes the object for every blob sharing it\n");
+    fprintf(stderr, "  --cache D   keep the entry table of every blob in the decode cache directory D\n");
+    fprintf(stderr, "              and read it back from there for blobs seen before\n");
+    fprintf(stderr, "  --cache-data  with --cache, also keep the decompressed assemblies\n");
+    fprintf(stderr, "  --pdb       with --extract or --tar, also write the debug symbols as <name>.pdb\n");
+    fprintf(stderr, "  --config    with --extract or --tar, also write the config as <name>.dll.config\n");
+    fprintf(stderr, "  --include P only keep assemblies whose name matches P, repeatable\n");
+    fprintf(stderr, "  --exclude P drop assemblies whose name matches P, repeatable\n");
+    fprintf(stderr, "              P is a glob (System.*) or a regex when prefixed with re:\n");
     return -1;
 }
 
@@ -16,32 +263,194 @@ int
 main(int argc, char *argv[])
 {
     const char *file = NULL;
+    const char *batch = NULL;
+    dump_options_T options = { 0 };
+    dump_stats_T stats = { 0 };
+    bool show_stats = false;
+    format_T format = FORMAT_PLAIN;
 
-    //TODO: parse flag to handle dlls extraction
-    if (argc >= 2 && argv[1] && *argv[1])
-        file = argv[1];
-    else
-        help(argv[0]);
+    // Pattern lists are NULL terminated, argc bounds the number of patterns.
+    const char **includes = calloc((size_t)argc, sizeof(char*));
+    const char **excludes = calloc((size_t)argc, sizeof(char*));
+    size_t include_count = 0;
+    size_t exclude_count = 0;
+
+    if (!includes || !excludes)
+        return -1;
+
+    // Listing only needs names and sizes, payloads are never decompressed.
+    options.list_only = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+
+        if (!arg || !*arg)
+            continue;
 
-    if (file && (strlen(file) > 1))
+        if (strcmp(arg, "--jobs") == 0 || strcmp(arg, "-j") == 0)
+        {
+            if ((i + 1) >= argc)
+                return help(argv[0]);
+
+            int jobs = atoi(argv[++i]);
+            if (jobs <= 0)
+                return help(argv[0]);
+
+            options.jobs = (unsigned int)jobs;
+        }
+        else if (strncmp(arg, "--jobs=", 7) == 0)
+        {
+            int jobs = atoi(arg + 7);
+            if (jobs <= 0)
+                return help(argv[0]);
+
+            options.jobs = (unsigned int)jobs;
+        }
+        else if (strcmp(arg, "--format") == 0)
+        {
+            if ((i + 1) >= argc || parse_format(argv[++i], &format) < 0)
+                return help(argv[0]);
+        }
+        else if (strncmp(arg, "--format=", 9) == 0)
+        {
+            if (parse_format(arg + 9, &format) < 0)
+                return help(argv[0]);
+        }
+        else if (strcmp(arg, "--stats") == 0)
+            show_stats = true;
+        else if (strcmp(arg, "--extract") == 0)
+            options.dump = true;
+        else if (strcmp(arg, "--writers") == 0)
+        {
+            if ((i + 1) >= argc)
+                return help(argv[0]);
+
+            int writers = atoi(argv[++i]);
+            if (writers < 0)
+                return help(argv[0]);
+
+            options.writers = (unsigned int)writers;
+        }
+        else if (strcmp(arg, "--tar") == 0)
+        {
+            if ((i + 1) >= argc)
+                return help(argv[0]);
+
+            options.archive = argv[++i];
+        }
+        else if (strcmp(arg, "--preallocate") == 0)
+            options.preallocate = true;
+        else if (strcmp(arg, "--direct") == 0)
+            options.direct_io = true;
+        else if (strcmp(arg, "--cas") == 0)
+        {
+            if ((i + 1) >= argc)
+                return help(argv[0]);
+
+            options.cas = argv[++i];
+        }
+        else if (strcmp(arg, "--sha256") == 0)
+            options.cas_sha256 = true;
+        else if (strcmp(arg, "--cas-link") == 0)
+            options.cas_hardlink = true;
+        else if (strcmp(arg, "--cache") == 0)
+        {
+            if ((i + 1) >= argc)
+                return help(argv[0]);
+
+            options.cache = argv[++i];
+        }
+        else if (strcmp(arg, "--cache-data") == 0)
+            options.cache_data = true;
+        else if (strcmp(arg, "--pdb") == 0)
+            options.debug_data = true;
+        else if (strcmp(arg, "--config") == 0)
+            options.config_data = true;
+        else if (strcmp(arg, "--include") == 0 || strcmp(arg, "--exclude") == 0)
+        {
+            if ((i + 1) >= argc)
+                return help(argv[0]);
+
+            if (arg[2] == 'i')
+                includes[include_count++] = argv[++i];
+            else
+                excludes[exclude_count++] = argv[++i];
+        }
+        else if (strncmp(arg, "--include=", 10) == 0)
+            includes[include_count++] = arg + 10;
+        else if (strncmp(arg, "--exclude=", 10) == 0)
+            excludes[exclude_count++] = arg + 10;
+        else if (strcmp(arg, "--batch") == 0)
+        {
+            if ((i + 1) >= argc)
+                return help(argv[0]);
+
+            batch = argv[++i];
+        }
+        else if (!file)
+            file = arg;
+        else
+            return help(argv[0]);
+    }
+
+    if (!file && !batch)
+        return help(argv[0]);
+
+    int ret = 0;
+
+    options.include = includes;
+    options.exclude = excludes;
+
+    if (batch || (file && (strlen(file) > 1)))
     {
-	    assembly_T *list = NULL;
+	    assembly_table_T table = { 0 };
 	    block_T *block = NULL;
 
-	    size_t count = assemblies_dump(&block, file, &list, false);
+	    // With the archive on stdout the listing goes to stderr.
+	    static out_T out;
+	    out.file = (options.archive && strcmp(options.archive, "-") == 0) ? stderr : stdout;
+
+	    emit_T emit = { &out, format, 0, NULL, 0 };
 
-	    if (list && count > 0)
+	    // Always counted: an unreadable blob has no index entries, one the
+	    // filters emptied has.
+	    options.stats = &stats;
+	    options.on_entry = emit_entry;
+	    options.ctx = &emit;
+
+	    if (format == FORMAT_JSON)
+		    out_write(&out, "[", 1);
+	    else if (format == FORMAT_TSV)
+		    out_printf(&out, "%sname\thash32\thash64\tindex\tdata_offset\tcompressed_size\tsize\tstore_id\tabi"
+                    "\tdebug_data_offset\tdebug_data_size\tconfig_data_offset\tconfig_data_size\tobject\n", batch ? "blob\t" : "");
+
+	    // A blob that cannot be opened or parsed fails the run so that
+	    // scripts can tell, filters matching nothing do not.
+	    if (batch)
+	    {
+		    const size_t dumped = dabu_dump_many(batch, &options, emit_blob, &emit);
+		    ret = (!dumped || dumped < emit.blobs) ? 1 : 0;
+	    }
+	    else
 	    {
-		    assembly_T *iter = list;
-		    while (iter)
-		    {
-			    if (iter->name[0]) printf("%s\n", iter->name);
-			    iter = iter->next;
-		    }
+		    const size_t count = assemblies_dump_options(&block, file, &table, &options);
+		    ret = (count || stats.entries) ? 0 : 1;
 	    }
 
+	    if (format == FORMAT_JSON)
+		    out_write(&out, (emit.records) ? "\n]\n" : "]\n", (emit.records) ? 3 : 2);
+
+	    out_flush(&out);
+
+	    if (show_stats)
+		    print_stats(&stats);
+
 	    block_free(&block);
     }
 
-    return 0;
+    free(includes);
+    free(excludes);
+
+    return ret;
 }
@@ -1,16 +1,73 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// O_DIRECT, fallocate() and copy_file_range()
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <inttypes.h>
+#include <errno.h>
 #include <assert.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <direct.h>
+#include <process.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <pthread.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <regex.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 
 #include "lz4.h"
 
 #include "dabu.h"
+#include "dabu_format.h"
 
 #define debug_env "dabu_debug"
-#define is_debug (getenv(debug_env) != NULL)
+#define is_debug debug_enabled()
+
+/*
+ * The environment is looked up once, not on every entry of the hot loop.
+ */
+bool
+debug_enabled(void)
+{
+    static int enabled = -1;
+
+    if (enabled < 0)
+        enabled = (getenv(debug_env) != NULL);
+
+    return enabled == 1;
+}
+
+double
+now_seconds(void)
+{
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
 
 typedef struct {
     char *buffer;
@@ -18,12 +75,451 @@ typedef struct {
     size_t size;
 } string_T;
 
+#define BLOCK_ALIGN 8
+#define BLOCK_MIN_CHUNK (64 * 1024)
+
+/*
+ * Arena made of one or more chunks. Allocations are served from the current
+ * chunk; when it runs out another chunk is chained instead of failing, so
+ * pointers handed out earlier stay valid.
+ */
 struct block_T {
     int8_t *buffer;
     size_t size;
     size_t offset;
+    struct block_T *next;
+    struct block_T *current;
 };
 
+/*
+ * A read-only view of a file. data/size is the window the parser works on,
+ * base/base_size the whole file; they differ when the blob is a member of
+ * an APK and is read in place. fd stays open with the mapping so stored
+ * payloads can be copied file to file, -1 when there is none.
+ */
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    bool mapped;
+    const uint8_t *base;
+    size_t base_size;
+    int fd;
+} mapping_T;
+
+int
+map_file(const char *path, mapping_T *map)
+{
+    if (!path || !map) return -1;
+
+    map->data = NULL;
+    map->size = 0;
+    map->mapped = false;
+    map->base = NULL;
+    map->base_size = 0;
+    map->fd = -1;
+
+#ifdef _WIN32
+    FILE *file = fopen(path, "rb");
+    if (!file) return -1;
+
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (len <= 0)
+    {
+        fclose(file);
+        return -1;
+    }
+
+    uint8_t *buffer = malloc((size_t)len);
+    if (!buffer || fread(buffer, (size_t)len, 1, file) != 1)
+    {
+        fprintf(stderr, "fread() failed file:%s:%d\n", __FILE__, __LINE__);
+        free(buffer);
+        fclose(file);
+        return -1;
+    }
+
+    fclose(file);
+
+    map->data = buffer;
+    map->size = (size_t)len;
+#else
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    void *ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (ptr == MAP_FAILED)
+    {
+        fprintf(stderr, "mmap() failed file:%s:%d\n", __FILE__, __LINE__);
+        close(fd);
+        return -1;
+    }
+
+    map->data = ptr;
+    map->size = (size_t)st.st_size;
+    map->mapped = true;
+    map->fd = fd;
+#endif
+
+    map->base = map->data;
+    map->base_size = map->size;
+
+    return 0;
+}
+
+void
+unmap_file(mapping_T *map)
+{
+    if (!map || !map->base) return;
+
+#ifdef _WIN32
+    free((void*)map->base);
+#else
+    if (map->mapped)
+        munmap((void*)map->base, map->base_size);
+
+    if (map->fd >= 0)
+        close(map->fd);
+#endif
+
+    map->data = NULL;
+    map->size = 0;
+    map->mapped = false;
+    map->base = NULL;
+    map->base_size = 0;
+    map->fd = -1;
+}
+
+/*
+ * Returns a pointer to size bytes at offset inside the mapping, or NULL when
+ * the range falls outside of it.
+ */
+const void *
+map_range(const mapping_T *map, const uint64_t offset, const uint64_t size)
+{
+    if (!map || !map->data) return NULL;
+
+    if (offset > map->size || size > (map->size - offset))
+        return NULL;
+
+    return map->data + offset;
+}
+
+#define ADVISE_SEQUENTIAL 1
+#define ADVISE_WILLNEED 2
+
+/*
+ * Tells the kernel how a range of the mapping is about to be read, widened
+ * to whole pages. WILLNEED starts the readahead right away. Mappings read
+ * into memory (Windows) need no advice.
+ */
+void
+map_advise(const mapping_T *map, const uint64_t offset, const uint64_t size, const int advice)
+{
+#ifndef _WIN32
+    if (!map->mapped || !size || !map_range(map, offset, size)) return;
+
+    const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = (uintptr_t)(map->data + offset) & ~(page - 1);
+    const uintptr_t end = (uintptr_t)(map->data + offset + size);
+
+    if (advice & ADVISE_SEQUENTIAL)
+        madvise((void*)begin, end - begin, MADV_SEQUENTIAL);
+
+    if (advice & ADVISE_WILLNEED)
+        madvise((void*)begin, end - begin, MADV_WILLNEED);
+#else
+    (void)map;
+    (void)offset;
+    (void)size;
+    (void)advice;
+#endif
+}
+
+/*
+ * APK and AAB files are ZIP archives. The blob is stored uncompressed in
+ * them, so it is parsed in place at its offset inside the archive mapping.
+ */
+#define ZIP_LOCAL_MAGIC 0x04034b50
+#define ZIP_CENTRAL_MAGIC 0x02014b50
+#define ZIP_EOCD_MAGIC 0x06054b50
+#define ZIP64_LOCATOR_MAGIC 0x07064b50
+#define ZIP64_EOCD_MAGIC 0x06064b50
+#define ZIP64_EXTRA_ID 0x0001
+#define ZIP_EOCD_SIZE 22
+#define ZIP_CENTRAL_SIZE 46
+#define ZIP_LOCAL_SIZE 30
+#define ZIP_METHOD_STORED 0
+
+#define ZIP_BLOB_NAME "assemblies/assemblies.blob"
+#define ZIP_MANIFEST_NAME "assemblies/assemblies.manifest"
+
+typedef struct {
+    uint64_t offset;
+    uint64_t size;
+    uint16_t method;
+    const char *name;
+    size_t name_len;
+} zip_entry_T;
+
+uint16_t
+read_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t
+read_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t
+read_u64(const uint8_t *p)
+{
+    return (uint64_t)read_u32(p) | ((uint64_t)read_u32(p + 4) << 32);
+}
+
+bool
+zip_is_archive(const mapping_T *map)
+{
+    const uint8_t *magic = map_range(map, 0, 4);
+    return magic && read_u32(magic) == ZIP_LOCAL_MAGIC;
+}
+
+/*
+ * Member names are matched on a path suffix: "assemblies/assemblies.blob"
+ * in an APK, "base/root/assemblies/assemblies.blob" in an AAB.
+ */
+bool
+zip_name_match(const uint8_t *name, const size_t len, const char *suffix)
+{
+    const size_t suffix_len = strlen(suffix);
+
+    if (len < suffix_len || memcmp(name + len - suffix_len, suffix, suffix_len) != 0)
+        return false;
+
+    return len == suffix_len || name[len - suffix_len - 1] == '/';
+}
+
+/*
+ * Reads the ZIP64 extended information of a central directory record for the
+ * fields the record itself marks as 0xFFFFFFFF.
+ */
+void
+zip64_extra(const uint8_t *extra, const size_t len, uint64_t *size, uint64_t *compressed, uint64_t *offset)
+{
+    size_t pos = 0;
+
+    while (pos + 4 <= len)
+    {
+        const uint16_t id = read_u16(extra + pos);
+        const uint16_t field_len = read_u16(extra + pos + 2);
+        const uint8_t *field = extra + pos + 4;
+        const uint8_t *field_end = field + field_len;
+
+        if (pos + 4 + field_len > len) return;
+
+        if (id == ZIP64_EXTRA_ID)
+        {
+            if (*size == UINT32_MAX && field + 8 <= field_end) { *size = read_u64(field); field += 8; }
+            if (*compressed == UINT32_MAX && field + 8 <= field_end) { *compressed = read_u64(field); field += 8; }
+            if (*offset == UINT32_MAX && field + 8 <= field_end) { *offset = read_u64(field); }
+            return;
+        }
+
+        pos += 4 + field_len;
+    }
+}
+
+/*
+ * Cursor over the central directory of an archive.
+ */
+typedef struct {
+    const mapping_T *map;
+    const uint8_t *cd;
+    uint64_t cd_size;
+    uint64_t entries;
+    uint64_t index;
+    size_t pos;
+} zip_iter_T;
+
+int
+zip_iter_init(const mapping_T *map, zip_iter_T *iter)
+{
+    memset(iter, 0, sizeof(zip_iter_T));
+    iter->map = map;
+
+    if (map->size < ZIP_EOCD_SIZE) return -1;
+
+    // The end of central directory record sits behind at most 64 KiB of
+    // archive comment.
+    const size_t floor = (map->size > (ZIP_EOCD_SIZE + 0xFFFF)) ? map->size - (ZIP_EOCD_SIZE + 0xFFFF) : 0;
+    size_t eocd = map->size - ZIP_EOCD_SIZE;
+    while (read_u32(map->data + eocd) != ZIP_EOCD_MAGIC)
+    {
+        if (eocd == floor) return -1;
+        eocd--;
+    }
+
+    const uint8_t *record = map->data + eocd;
+    uint64_t entries = read_u16(record + 10);
+    uint64_t cd_size = read_u32(record + 12);
+    uint64_t cd_offset = read_u32(record + 16);
+
+    if (entries == UINT16_MAX || cd_size == UINT32_MAX || cd_offset == UINT32_MAX)
+    {
+        const uint8_t *locator = (eocd >= 20) ? map_range(map, eocd - 20, 20) : NULL;
+        if (!locator || read_u32(locator) != ZIP64_LOCATOR_MAGIC)
+            return -1;
+
+        const uint8_t *eocd64 = map_range(map, read_u64(locator + 8), 56);
+        if (!eocd64 || read_u32(eocd64) != ZIP64_EOCD_MAGIC)
+            return -1;
+
+        entries = read_u64(eocd64 + 32);
+        cd_size = read_u64(eocd64 + 40);
+        cd_offset = read_u64(eocd64 + 48);
+    }
+
+    iter->cd = map_range(map, cd_offset, cd_size);
+    if (!iter->cd) return -1;
+
+    iter->cd_size = cd_size;
+    iter->entries = entries;
+
+    return 0;
+}
+
+/*
+ * Moves to the next member. Returns 1 with its central directory record,
+ * 0 at the end of the directory and -1 when the directory is malformed.
+ */
+int
+zip_iter_next(zip_iter_T *iter, const uint8_t **record)
+{
+    if (iter->index >= iter->entries || iter->pos + ZIP_CENTRAL_SIZE > iter->cd_size)
+        return 0;
+
+    const uint8_t *entry = iter->cd + iter->pos;
+    if (read_u32(entry) != ZIP_CENTRAL_MAGIC)
+        return -1;
+
+    const size_t next = iter->pos + ZIP_CENTRAL_SIZE + read_u16(entry + 28) + read_u16(entry + 30) + read_u16(entry + 32);
+    if (next > iter->cd_size) return -1;
+
+    iter->pos = next;
+    iter->index++;
+    *record = entry;
+
+    return 1;
+}
+
+/*
+ * Resolves where the data of a member starts from its central directory
+ * record and its local header.
+ */
+int
+zip_member(const mapping_T *map, const uint8_t *record, zip_entry_T *out)
+{
+    const uint16_t name_len = read_u16(record + 28);
+    const uint16_t extra_len = read_u16(record + 30);
+
+    uint64_t compressed = read_u32(record + 20);
+    uint64_t size = read_u32(record + 24);
+    uint64_t local_offset = read_u32(record + 42);
+
+    zip64_extra(record + ZIP_CENTRAL_SIZE + name_len, extra_len, &size, &compressed, &local_offset);
+
+    // The local header's extra field may differ from the central one.
+    const uint8_t *local = map_range(map, local_offset, ZIP_LOCAL_SIZE);
+    if (!local || read_u32(local) != ZIP_LOCAL_MAGIC)
+        return -1;
+
+    out->method = read_u16(record + 10);
+    out->offset = local_offset + ZIP_LOCAL_SIZE + read_u16(local + 26) + read_u16(local + 28);
+    out->size = compressed;
+    out->name = (const char*)record + ZIP_CENTRAL_SIZE;
+    out->name_len = name_len;
+
+    return map_range(map, out->offset, out->size) ? 0 : -1;
+}
+
+/*
+ * Finds the member whose name ends with suffix. Returns -1 when the archive
+ * is malformed or has no such member.
+ */
+int
+zip_find(const mapping_T *map, const char *suffix, zip_entry_T *out)
+{
+    zip_iter_T iter;
+    if (zip_iter_init(map, &iter) < 0) return -1;
+
+    const uint8_t *record = NULL;
+    while (zip_iter_next(&iter, &record) > 0)
+    {
+        if (zip_name_match(record + ZIP_CENTRAL_SIZE, read_u16(record + 28), suffix))
+            return zip_member(map, record, out);
+    }
+
+    return -1;
+}
+
+/*
+ * Narrows an APK/AAB mapping to its assemblies.blob member. A stored
+ * assemblies.manifest member, when the archive has one, is returned through
+ * manifest/manifest_size, it stays valid as long as the mapping. The blob
+ * member itself is returned in blob_member.
+ */
+int
+zip_open_store(mapping_T *map, const char *path, const char **manifest, size_t *manifest_size, zip_entry_T *blob_member)
+{
+    zip_entry_T blob = { 0 };
+    zip_entry_T member = { 0 };
+
+    *manifest = NULL;
+    *manifest_size = 0;
+
+    if (zip_find(map, ZIP_BLOB_NAME, &blob) < 0)
+    {
+        fprintf(stderr, "%s has no %s member\n", path, ZIP_BLOB_NAME);
+        return -1;
+    }
+
+    if (blob.method != ZIP_METHOD_STORED)
+    {
+        fprintf(stderr, "%s in %s is compressed, it cannot be read in place\n", ZIP_BLOB_NAME, path);
+        return -1;
+    }
+
+    if (zip_find(map, ZIP_MANIFEST_NAME, &member) == 0)
+    {
+        if (member.method == ZIP_METHOD_STORED)
+        {
+            *manifest = (const char*)map->data + member.offset;
+            *manifest_size = (size_t)member.size;
+        }
+        else
+            fprintf(stderr, "%s in %s is compressed, names fall back to hashes\n", ZIP_MANIFEST_NAME, path);
+    }
+
+    map->data += blob.offset;
+    map->size = (size_t)blob.size;
+    *blob_member = blob;
+
+    return 0;
+}
+
 block_T*
 block_create(const size_t size)
 {
@@ -37,9 +533,17 @@ block_create(const size_t size)
     }
 
     ptr->buffer = calloc(1, (sizeof(uint8_t) * size));
+    if (!ptr->buffer)
+    {
+        fprintf(stderr, "calloc() failed when allocating 0x%zx bytes for block_T\n", size);
+        free(ptr);
+        return NULL;
+    }
 
     ptr->size = size;
     ptr->offset = 0;
+    ptr->next = NULL;
+    ptr->current = ptr;
 
     return ptr;
 }
@@ -49,8 +553,51 @@ block_reset(block_T *block)
 {
     if (block)
     {
-        block->offset = 0;
+        // Chained chunks are kept around so a reused block does not have to
+        // grow again.
+        for (block_T *iter = block; iter; iter = iter->next)
+            iter->offset = 0;
+
+        block->current = block;
+    }
+}
+
+/*
+ * Bytes handed out by the block since it was created or last reset.
+ */
+size_t
+block_used(const block_T *block)
+{
+    size_t used = 0;
+
+    for (const block_T *iter = block; iter; iter = iter->next)
+        used += iter->offset;
+
+    return used;
+}
+
+/*
+ * Makes sure a (reset) block holds at least size bytes, chaining one more
+ * chunk for the difference when it does not.
+ */
+int
+block_reserve(block_T *block, const size_t size)
+{
+    if (!block) return -1;
+
+    size_t total = 0;
+    block_T *tail = block;
+    for (block_T *iter = block; iter; iter = iter->next)
+    {
+        total += iter->size;
+        tail = iter;
     }
+
+    if (total >= size) return 0;
+
+    tail->next = block_create(size - total);
+
+    return tail->next ? 0 : -1;
 }
 
 void
@@ -58,13 +605,21 @@ block_free(block_T **block)
 {
     if (block && *block)
     {
-        if ((*block)->buffer)
+        block_T *iter = *block;
+        while (iter)
         {
-            free((*block)->buffer);
-            (*block)->buffer = NULL;
+            block_T *next = iter->next;
+
+            if (iter->buffer)
+            {
+                free(iter->buffer);
+                iter->buffer = NULL;
+            }
+
+            free(iter);
+            iter = next;
         }
 
-        free(*block);
         *block = NULL;
     }
 }
@@ -72,14 +627,32 @@ block_free(block_T **block)
 void *
 block_alloc(block_T *block, const size_t size)
 {
-    if ((block->offset + size) > block->size)
+    if (!block) return NULL;
+
+    const size_t aligned = (size + (BLOCK_ALIGN - 1)) & ~((size_t)BLOCK_ALIGN - 1);
+    if (aligned < size) return NULL;
+
+    block_T *chunk = block->current;
+
+    while ((chunk->offset + aligned) > chunk->size)
     {
-        fprintf(stderr,"block_T out of memory! current block size: 0x%lx requested size: 0x%lx\n", block->size, size);
-        return NULL;
+        if (!chunk->next)
+        {
+            const size_t grow = (aligned > BLOCK_MIN_CHUNK) ? aligned : BLOCK_MIN_CHUNK;
+            chunk->next = block_create(grow);
+            if (!chunk->next)
+            {
+                fprintf(stderr,"block_T out of memory! current block size: 0x%zx requested size: 0x%zx\n", chunk->size, size);
+                return NULL;
+            }
+        }
+
+        chunk = chunk->next;
+        block->current = chunk;
     }
 
-    void *ptr = block->buffer + block->offset;
-    block->offset += size;
+    void *ptr = chunk->buffer + chunk->offset;
+    chunk->offset += aligned;
 
     return ptr;
 }
@@ -99,6 +672,7 @@ string_new(block_T *block, const char *text)
     }
 
     ptr->buffer = block_alloc(block, cap);
+    if (!ptr->buffer) return NULL;
     memcpy(ptr->buffer, text, cap);
     ptr->size = ptr->cap = cap;
 
@@ -122,145 +696,108 @@ string_concat(block_T *block, const char *text, const char *extra)
     }
 
     ptr->buffer = block_alloc(block, cap);
-    strncpy(ptr->buffer, text, text_len);
-    strncat(ptr->buffer, extra, extra_len);
-    ptr->buffer[len] = '\0';
+    if (!ptr->buffer) return NULL;
+    memcpy(ptr->buffer, text, text_len);
+    memcpy(ptr->buffer + text_len, extra, extra_len);
+    ptr->buffer[len - 1] = '\0';
     ptr->size = ptr->cap = cap;
 
     return ptr;
 }
 
-#define XABA_MAGIC 0x41424158
-#define XALZ_MAGIC 0x5a4c4158
-
-#pragma pack(push, 1)
-typedef struct header_T {
-    uint32_t magic;
-    uint32_t version;
-    uint32_t entry_count;
-    uint32_t index_entry_count;
-    uint32_t index_size;
-} header_T;
-#pragma pack(pop)
-
-#pragma pack(push, 1)
-typedef struct descriptor_T {
-    uint32_t data_offset;
-    uint32_t data_size;
-    uint32_t debug_data_offset;
-    uint32_t debug_data_size;
-    uint32_t config_data_offset;
-    uint32_t config_data_size;
-} descriptor_T;
-#pragma pack(pop)
-
-#pragma pack(push, 1)
-typedef struct hash_T {
-    union {
-        uint32_t hash32;
-        uint64_t hash64;
-    };
-    uint32_t mapping_index;
-    uint32_t local_store_index;
-    uint32_t store_id;
-} hash_T;
-#pragma pack(pop)
-
-#pragma pack(push, 1)
-typedef struct {
-        uint32_t magic;
-        uint32_t index;
-        uint32_t size;
-} xalz_T;
-#pragma pack(pop)
-
 void
 list_init(block_T **block, assembly_T **list, const size_t size)
 {
     *list = block_alloc(*block, size);
-    if (list && *list) (*list)->next = NULL;
+    if (list && *list)
+    {
+        (*list)->name[0] = '\0';
+        (*list)->size = 0;
+        (*list)->next = NULL;
+    }
 }
 
 void
 list_append(
 	block_T **block,
-	assembly_T **list,
+	assembly_T **tail,
 	const char *name,
 	const size_t size)
 {
-    assembly_T *iter = *list;
-
-    while (iter && iter->next)
-        iter = iter->next;
-
     assembly_T *new_node = block_alloc(*block, sizeof(assembly_T));
     if (!new_node)
         return;
 
+    const size_t len = strlen(name);
+    const size_t copy = (len < MAX_NAME - 1) ? len : MAX_NAME - 1;
+
     new_node->next = NULL;
-    memcpy(new_node->name, name, MAX_NAME);
+    memcpy(new_node->name, name, copy);
+    new_node->name[copy] = '\0';
     new_node->size = size;
 
-    if (iter)
-        iter->next = new_node;
-    else
-        *list = new_node;
+    if (*tail)
+        (*tail)->next = new_node;
+
+    *tail = new_node;
 }
 
 int
-read_header(const FILE *file, header_T *header)
+read_header(const mapping_T *map, header_T *header)
 {
+    const header_T *ptr = map_range(map, 0, sizeof(header_T));
 
-    if (file == NULL)
-        return -1;
-
-    fseek((FILE*)file, 0, SEEK_SET);
-
-    if (fread(
-            header,
-            sizeof(struct header_T),
-            1,
-            (FILE*)file) != 1)
+    if (ptr == NULL)
     {
-        fprintf(stderr, "fread() failed fie:%s:%d\n", __FILE__, __LINE__);
+        fprintf(stderr, "blob too small to hold a header file:%s:%d\n", __FILE__, __LINE__);
         return -1;
     }
 
+    memcpy(header, ptr, sizeof(header_T));
+
     return 0;
 }
 
-hash_T*
-get_hash(hash_T *list, const size_t size, const size_t index)
+const hash_T*
+get_hash(const hash_T *list, const size_t size, const size_t index)
 {
     if (!list
-            || index > size)
+            || index >= size)
         return NULL;
 
-    hash_T *ptr = &list[index];
+    const hash_T *ptr = &list[index];
     return ptr;
 }
 
-descriptor_T*
-get_descriptor(descriptor_T *list, size_t size, const uint32_t index)
+const descriptor_T*
+get_descriptor(const descriptor_T *list, size_t size, const uint32_t index)
 {
     if (!list
-            || index > size)
+            || index >= size)
         return NULL;
 
-    descriptor_T *ptr = &list[index];
+    const descriptor_T *ptr = &list[index];
     return ptr;
 }
 
+/*
+ * Replaces the extension of the last path component, or appends ext when it
+ * has none.
+ */
 const char*
 change_file_ext(block_T *block, const char* path, const char* ext)
 {
     if (!path || !ext) return NULL;
 
-    const char* last_token = strrchr(path, '.');
-    if (!last_token) return NULL;
+    const char *base = path;
+    for (const char *iter = path; *iter; iter++)
+        if (*iter == '/' || *iter == '\\') base = iter + 1;
+
+    const char* last_token = strrchr(base, '.');
+    if (!last_token || last_token == base)
+        last_token = base + strlen(base);
 
     size_t ext_len = strlen(ext);
-    if ((char)last_token[1] != 0x62) return NULL;
 
     size_t len = last_token - path;
     if (len <= 0) return NULL;
@@ -268,8 +805,8 @@ change_file_ext(block_T *block, const char* path, const char* ext)
     char* new_path = block_alloc(block, len + ext_len + 1);
     if (!new_path) return NULL;
 
-    strncpy(new_path, path, len);
-    strncat(new_path, ext, ext_len);
+    memcpy(new_path, path, len);
+    memcpy(new_path + len, ext, ext_len);
     new_path[len + ext_len] = '\0';
 
     return new_path;
@@ -299,352 +836,4346 @@ get_parent_dir(block_T *block, const char* path)
     return dir;
 }
 
-char*
-get_dllname_from_manifest(block_T *block, const FILE* file, const uint64_t hash)
+/*
+ * Creates the directory name below dir (or the working directory when dir is
+ * NULL). An existing directory is not an error.
+ */
+int
+make_dir(block_T *block, const char *dir, const char *name)
 {
-    uint32_t hash32 = 0;
-    uint64_t hash64 = 0;
-    uint32_t index = 0;
-    uint32_t index2 = 0;
-    char filename[4096] = { 0 };
-    char buf[1024] = { 0 };
-
-	rewind((FILE*)file);
-
-	while (fgets(buf, sizeof(buf), (FILE*)file))
-	{
-		size_t ret = sscanf(buf, "0x%x  0x%lx  %d      %d      %s", &hash32, &hash64, &index, &index2, filename);
-		if (ret == 5)
-		{
-			if (hash32 == (uint32_t)hash || hash64 == hash)
-			{
-                if ((strlen(filename) + 5) <= sizeof(filename))
-                {
-                    size_t len = strlen(filename);
-                    filename[len] = '.';
-                    filename[len+1] = 'd';
-                    filename[len+2] = 'l';
-                    filename[len+3] = 'l';
-                    filename[len+4] = '\0';
-                    char *underscore = strrchr(filename, '/');
-                    if (underscore) underscore[0] = '_';
-                    const size_t size = strlen(filename) + 1;
-                    void *ptr = block_alloc(block, size);
-                    if (!ptr)
-                    {
-                        fprintf(stderr, "block_alloc() failed\n");
-                        return NULL;
-                    }
-                    memcpy(ptr, filename, size);
-                    return ptr;
-                }
-			}
-		}
-	}
+    string_T *path = (dir) ? string_concat(block, dir, name) : string_new(block, name);
+    if (!path)
+    {
+        fprintf(stderr, "string operation failed\n");
+        return -1;
+    }
+
+#ifdef _WIN32
+    const int ret = _mkdir(path->buffer);
+#else
+    const int ret = mkdir(path->buffer, 0755);
+#endif
+
+    if (ret < 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "mkdir() failed for %s: %s\n", path->buffer, strerror(errno));
+        return -1;
+    }
 
-	return NULL;
+    return 0;
 }
 
+typedef struct {
+    uint32_t hash32;
+    uint64_t hash64;
+    const char *name;
+} manifest_entry_T;
+
+/*
+ * assemblies.manifest parsed once into the arena. Both tables are open
+ * addressing with linear probing and hold entry index + 1, 0 marks an empty
+ * slot.
+ */
+typedef struct {
+    manifest_entry_T *entries;
+    size_t count;
+    uint32_t *by_hash32;
+    uint32_t *by_hash64;
+    size_t mask;
+} manifest_T;
+
 size_t
-write_file(const char *filename, char *data, size_t size)
+manifest_slot(const uint64_t hash, const size_t mask)
 {
-    if (!filename || !data || size <= 0) return -1;
-    FILE *file = fopen(filename, "wb");
+    return (size_t)((hash * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
 
-    if (!file) return -1;
+#define MANIFEST_FIELDS 5
 
-    size_t ret = fwrite(data, sizeof(char), size, file);
+bool
+parse_hex(const char *text, const size_t len, uint64_t *value)
+{
+    char buf[24] = { 0 };
 
-    fclose(file);
+    if (len < 3 || len >= sizeof(buf) || text[0] != '0' || (text[1] != 'x' && text[1] != 'X'))
+        return false;
 
-    return ret;
+    memcpy(buf, text, len);
+
+    char *end = NULL;
+    *value = strtoull(buf, &end, 16);
+
+    return end && *end == '\0';
 }
 
+/*
+ * Parses "0x<hash32>  0x<hash64>  <blob id>  <blob idx>  <name>" and turns the
+ * name into the file name used on disk: ".dll" appended and the culture
+ * separator of satellite assemblies replaced by '_'. Returns false for lines
+ * that are not entries, such as the column header.
+ */
+bool
+parse_manifest_line(block_T *block, const char *line, const char *end, manifest_entry_T *entry)
+{
+    const char *fields[MANIFEST_FIELDS] = { 0 };
+    size_t lengths[MANIFEST_FIELDS] = { 0 };
+    size_t n = 0;
+
+    const char *iter = line;
+    while (iter < end && n < MANIFEST_FIELDS)
+    {
+        while (iter < end && (*iter == ' ' || *iter == '\t' || *iter == '\r')) iter++;
+        if (iter >= end) break;
+
+        fields[n] = iter;
+        while (iter < end && *iter != ' ' && *iter != '\t' && *iter != '\r') iter++;
+        lengths[n] = iter - fields[n];
+        n++;
+    }
+
+    if (n != MANIFEST_FIELDS) return false;
+
+    uint64_t hash32 = 0;
+    uint64_t hash64 = 0;
+    if (!parse_hex(fields[0], lengths[0], &hash32) || !parse_hex(fields[1], lengths[1], &hash64))
+        return false;
+
+    const size_t len = lengths[4];
+    char *name = block_alloc(block, len + sizeof(".dll"));
+    if (!name)
+    {
+        fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+        return false;
+    }
+
+    memcpy(name, fields[4], len);
+    memcpy(name + len, ".dll", sizeof(".dll"));
+
+    char *underscore = strrchr(name, '/');
+    if (underscore) underscore[0] = '_';
+
+    entry->hash32 = (uint32_t)hash32;
+    entry->hash64 = hash64;
+    entry->name = name;
+
+    return true;
+}
+
+void
+manifest_insert(uint32_t *table, const size_t mask, const manifest_entry_T *entries, const uint64_t hash, const bool wide, const uint32_t index)
+{
+    size_t slot = manifest_slot(hash, mask);
+
+    while (table[slot])
+    {
+        const manifest_entry_T *other = &entries[table[slot] - 1];
+
+        // Keep the first occurrence, the same way a top-down scan would.
+        if ((wide && other->hash64 == hash) || (!wide && other->hash32 == (uint32_t)hash))
+            return;
+
+        slot = (slot + 1) & mask;
+    }
+
+    table[slot] = index + 1;
+}
+
+int
+manifest_parse(block_T *block, const char *text, const size_t size, manifest_T *manifest)
+{
+    if (!block || !text || !manifest) return -1;
+
+    memset(manifest, 0, sizeof(manifest_T));
+
+    const char *end = text + size;
+
+    size_t lines = 1;
+    for (const char *iter = text; iter < end; iter++)
+        if (*iter == '\n') lines++;
+
+    size_t cap = 16;
+    while (cap < (lines * 2)) cap <<= 1;
+
+    manifest->entries = block_alloc(block, lines * sizeof(manifest_entry_T));
+    manifest->by_hash32 = block_alloc(block, cap * sizeof(uint32_t));
+    manifest->by_hash64 = block_alloc(block, cap * sizeof(uint32_t));
+    if (!manifest->entries || !manifest->by_hash32 || !manifest->by_hash64)
+    {
+        fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    memset(manifest->by_hash32, 0, cap * sizeof(uint32_t));
+    memset(manifest->by_hash64, 0, cap * sizeof(uint32_t));
+    manifest->mask = cap - 1;
+
+    const char *line = text;
+    while (line < end)
+    {
+        const char *eol = memchr(line, '\n', end - line);
+        if (!eol) eol = end;
+
+        manifest_entry_T *entry = &manifest->entries[manifest->count];
+        if (parse_manifest_line(block, line, eol, entry))
+        {
+            const uint32_t index = (uint32_t)manifest->count++;
+            manifest_insert(manifest->by_hash32, manifest->mask, manifest->entries, entry->hash32, false, index);
+            manifest_insert(manifest->by_hash64, manifest->mask, manifest->entries, entry->hash64, true, index);
+        }
+
+        line = eol + 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Maps the <stem>.manifest next to a blob on disk. It is mapped before the
+ * arena exists, as it is part of the cache fingerprint, and parsed later.
+ */
+int
+manifest_load(const char *path, mapping_T *map)
+{
+    if (!path || !map) return -1;
+
+    const char *base = path;
+    for (const char *iter = path; *iter; iter++)
+        if (*iter == '/' || *iter == '\\') base = iter + 1;
+
+    const char *ext = strrchr(base, '.');
+    if (!ext || ext == base)
+        ext = base + strlen(base);
+
+    const size_t len = (size_t)(ext - path);
+    char *manifest_path = malloc(len + sizeof(".manifest"));
+    if (!manifest_path) return -1;
+
+    memcpy(manifest_path, path, len);
+    memcpy(manifest_path + len, ".manifest", sizeof(".manifest"));
+
+    const int ret = map_file(manifest_path, map);
+
+    free(manifest_path);
+
+    return ret;
+}
+
+const char*
+manifest_find32(const manifest_T *manifest, const uint32_t hash)
+{
+    if (!manifest || !manifest->count) return NULL;
+
+    size_t slot = manifest_slot(hash, manifest->mask);
+
+    while (manifest->by_hash32[slot])
+    {
+        const manifest_entry_T *entry = &manifest->entries[manifest->by_hash32[slot] - 1];
+        if (entry->hash32 == hash)
+            return entry->name;
+
+        slot = (slot + 1) & manifest->mask;
+    }
+
+    return NULL;
+}
+
+const char*
+manifest_find64(const manifest_T *manifest, const uint64_t hash)
+{
+    if (!manifest || !manifest->count) return NULL;
+
+    size_t slot = manifest_slot(hash, manifest->mask);
+
+    while (manifest->by_hash64[slot])
+    {
+        const manifest_entry_T *entry = &manifest->entries[manifest->by_hash64[slot] - 1];
+        if (entry->hash64 == hash)
+            return entry->name;
+
+        slot = (slot + 1) & manifest->mask;
+    }
+
+    return NULL;
+}
+
+#define ENTRY_UNRESOLVED 0
+#define ENTRY_VALID 1
+#define ENTRY_INVALID 2
+
+// file_of keeps the file of an entry in one byte.
+#define STORE_MAX_FILES (UINT8_MAX + 1)
+#define STORE_ABI_SIZE 32
+
+/*
+ * One file of a store set. The primary store (assemblies.blob) carries the
+ * hash index for the whole set, the per-ABI stores next to it
+ * (assemblies.<abi>.blob) only their descriptors and payloads. Every ABI
+ * store of a set shares one store id and lists the same assemblies.
+ */
+typedef struct {
+    mapping_T map;
+    bool owns_map;
+    header_T header;
+    const descriptor_T *descriptors;
+    char abi[STORE_ABI_SIZE];
+    uint32_t *by_descriptor;
+} store_file_T;
+
+/*
+ * Decode cache file, <cache>/<fingerprint>.dabc: the header, one record per
+ * entry slot of the store set, the names and, when cached, the decoded
+ * assemblies. Payloads start on a CACHE_ALIGN boundary so they can be
+ * cloned out of the file by copy_file_range().
+ */
+#define CACHE_MAGIC 0x43424144
+#define CACHE_VERSION 1
+#define CACHE_ALIGN 4096
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fingerprint;
+    uint64_t blob_size;
+    uint32_t entry_count;
+    uint32_t reserved;
+    uint64_t strings_size;
+} cache_header_T;
+
+/*
+ * payload_offset is 0 when the assembly of the slot is not cached.
+ */
+typedef struct {
+    uint64_t payload_offset;
+    uint32_t name_offset;
+    uint32_t name_len;
+    uint32_t index;
+    uint32_t hash32;
+    uint32_t size;
+    uint8_t file;
+    uint8_t state;
+    uint8_t compressed;
+    uint8_t reserved;
+} cache_entry_T;
+
+/*
+ * A parsed store set: the files, the index used in place from the primary
+ * one and one metadata entry per hash32list slot and matching file, so an
+ * architecture specific assembly gets one entry per ABI. XALZ headers are
+ * only read when an entry is resolved, payloads only when it is decoded.
+ */
+struct dabu_T {
+    store_file_T *files;
+    size_t file_count;
+    block_T *block;
+    bool owns_block;
+    const hash_T *hash32list;
+    const hash_T *hash64list;
+    size_t index_count;
+    manifest_T manifest;
+    assembly_entry_T *entries;
+    uint8_t *state;
+    uint8_t *file_of;
+    size_t count;
+    const char *path;
+    // The decode cache the entries were read from, cached is NULL without.
+    const char *cache_dir;
+    uint64_t fingerprint;
+    uint64_t blob_size;
+    mapping_T cache;
+    const cache_entry_T *cached;
+};
+
+/*
+ * LZ4 cannot expand a block by more than 255 times, anything claiming a
+ * larger decompressed size is malformed.
+ */
+#define LZ4_MAX_RATIO 255
+
+/*
+ * Stores built without compression keep each assembly as a plain PE image.
+ */
+bool
+payload_is_raw(const uint8_t *payload, const uint32_t size)
+{
+    return size >= 2 && payload[0] == 'M' && payload[1] == 'Z';
+}
+
+bool
+xalz_size_valid(const xalz_T *xalz, const uint32_t stored_size)
+{
+    if (xalz->size <= 0 || stored_size <= sizeof(xalz_T))
+        return false;
+
+    if (xalz->size > LZ4_MAX_INPUT_SIZE || stored_size > LZ4_MAX_INPUT_SIZE)
+        return false;
+
+    return (uint64_t)xalz->size <= ((uint64_t)(stored_size - sizeof(xalz_T)) * LZ4_MAX_RATIO);
+}
+
+#define PLAN_NAME_SIZE 256
+
+/*
+ * Sizes the arena from what the store set really decompresses to: walks the
+ * index once, reading only the XALZ headers, and adds the per-entry
+ * bookkeeping (list node, names and output path) for every file an index
+ * slot resolves to. Without payloads only the metadata is accounted for and
+ * no payload page is touched. With the records of the decode cache the
+ * sizes come from there instead of the XALZ headers. Names longer than the
+ * estimate are served from an extra chunk by block_alloc().
+ */
+size_t
+plan_arena_size(
+        const store_file_T *files,
+        const size_t file_count,
+        const hash_T *hashes,
+        const size_t count,
+        const size_t path_len,
+        const bool with_payloads,
+        const cache_entry_T *cached)
+{
+    const size_t path_size = path_len + PLAN_NAME_SIZE + (BLOCK_ALIGN * 2);
+    size_t total = sizeof(assembly_T) + (path_size * 2) + sizeof(dabu_T);
+
+    total += file_count * (sizeof(store_file_T) + BLOCK_ALIGN);
+
+    for (size_t f = 0; f < file_count; f++)
+        total += files[f].header.entry_count * (sizeof(uint64_t) + sizeof(uint32_t));
+
+    size_t slot = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        total += sizeof(manifest_entry_T) + (sizeof(uint32_t) * 8) + PLAN_NAME_SIZE;
+
+        const hash_T *hash = get_hash(hashes, count, i);
+        const size_t first = slot;
+
+        for (size_t f = 0; f < file_count; f++)
+        {
+            if (!hash || files[f].header.store_id != hash->store_id)
+                continue;
+
+            total += sizeof(assembly_entry_T) + (sizeof(uint8_t) * 2);
+            const cache_entry_T *record = (cached && cached[slot].state != ENTRY_UNRESOLVED) ? &cached[slot] : NULL;
+            slot++;
+
+            if (!with_payloads) continue;
+
+            xalz_T xalz = { 0 };
+            if (record)
+            {
+                if (record->state != ENTRY_VALID) continue;
+                xalz.size = record->size;
+            }
+            else
+            {
+                const descriptor_T *dsc = get_descriptor(files[f].descriptors, files[f].header.entry_count, hash->local_store_index);
+                if (!dsc) continue;
+
+                // Stored assemblies are planned at their stored size.
+                const uint8_t *payload = map_range(&files[f].map, dsc->data_offset, dsc->data_size);
+                const xalz_T *xalz_ptr = map_range(&files[f].map, dsc->data_offset, sizeof(xalz_T));
+
+                if (payload && payload_is_raw(payload, dsc->data_size))
+                    xalz.size = dsc->data_size;
+                else if (!xalz_ptr)
+                    continue;
+                else
+                {
+                    memcpy(&xalz, xalz_ptr, sizeof(xalz_T));
+                    if (xalz.magic != XALZ_MAGIC || !xalz_size_valid(&xalz, dsc->data_size))
+                        continue;
+                }
+            }
+
+            total += xalz.size + BLOCK_ALIGN;
+            total += sizeof(assembly_T) + sizeof(assembly_entry_T);
+            total += (sizeof(bool) * 2) + (sizeof(void*) * 4);
+            total += sizeof(string_T) + path_size;
+
+            // ABI entries are written below a directory named after the ABI.
+            if (files[f].abi[0])
+                total += (sizeof(string_T) + STORE_ABI_SIZE + PLAN_NAME_SIZE + (BLOCK_ALIGN * 2)) * 2;
+        }
+
+        // An index slot without a file still gets an (invalid) entry.
+        if (slot == first)
+            slot++;
+    }
+
+    return total;
+}
+
+size_t
+write_file(const char *filename, char *data, size_t size)
+{
+    if (!filename || !data || size <= 0) return -1;
+    FILE *file = fopen(filename, "wb");
+
+    if (!file) return -1;
+
+    size_t ret = fwrite(data, sizeof(char), size, file);
+
+    fclose(file);
+
+    return ret;
+}
+
+#define WRITE_PREALLOCATE 0x1
+#define WRITE_DIRECT 0x2
+
+// O_DIRECT wants the buffer, the file offset and the length aligned to the
+// logical block size; 4 KiB covers the devices we write to.
+#define DIRECT_ALIGN 4096
+#define DIRECT_CHUNK (1024 * 1024)
+
+#ifndef _WIN32
+bool
+write_all(const int fd, const char *data, const size_t size, size_t offset)
+{
+    while (offset < size)
+    {
+        ssize_t ret = pwrite(fd, data + offset, size - offset, (off_t)offset);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) return false;
+
+        offset += (size_t)ret;
+    }
+
+    return true;
+}
+
+#ifdef O_DIRECT
+/*
+ * Writes through an aligned bounce buffer, the tail is padded to the
+ * alignment and the file truncated back to size afterwards. Returns the
+ * number of bytes written before the file system refused direct I/O, the
+ * caller finishes those files with buffered writes.
+ */
+size_t
+write_direct(const int fd, const char *data, const size_t size)
+{
+    const size_t cap = (size < DIRECT_CHUNK) ? ((size + DIRECT_ALIGN - 1) & ~((size_t)DIRECT_ALIGN - 1)) : DIRECT_CHUNK;
+
+    void *bounce = NULL;
+    if (posix_memalign(&bounce, DIRECT_ALIGN, cap) != 0)
+        return 0;
+
+    size_t done = 0;
+    while (done < size)
+    {
+        const size_t len = (size - done < cap) ? size - done : cap;
+        const size_t padded = (len + DIRECT_ALIGN - 1) & ~((size_t)DIRECT_ALIGN - 1);
+
+        memcpy(bounce, data + done, len);
+        memset((char*)bounce + len, 0, padded - len);
+
+        ssize_t ret = pwrite(fd, bounce, padded, (off_t)done);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret != (ssize_t)padded) break;
+
+        done += len;
+    }
+
+    free(bounce);
+
+    if (done == size && (size % DIRECT_ALIGN) && ftruncate(fd, (off_t)size) != 0)
+        return 0;
+
+    return done;
+}
+#endif
+#endif
+
+/*
+ * write_file() with an optional fallocate() of the final size, so the file
+ * system places the file in one go, and optional O_DIRECT, which keeps
+ * extracted assemblies out of the page cache. Both are hints: file systems
+ * without support get plain buffered writes.
+ */
+size_t
+write_output(const char *filename, const char *data, const size_t size, const int flags)
+{
+#ifdef _WIN32
+    (void)flags;
+    return write_file(filename, (char*)data, size);
+#else
+    if (!filename || !data || size <= 0) return 0;
+
+    int open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    int fd = -1;
+
+#ifdef O_DIRECT
+    bool direct = (flags & WRITE_DIRECT) != 0;
+    if (direct)
+    {
+        fd = open(filename, open_flags | O_DIRECT, 0644);
+        direct = (fd >= 0);
+    }
+#endif
+
+    if (fd < 0)
+        fd = open(filename, open_flags, 0644);
+
+    if (fd < 0) return 0;
+
+#ifdef __linux__
+    if (flags & WRITE_PREALLOCATE)
+        (void)fallocate(fd, 0, 0, (off_t)size);
+#endif
+
+    size_t done = 0;
+
+#ifdef O_DIRECT
+    if (direct)
+    {
+        done = write_direct(fd, data, size);
+
+        if (done < size)
+            (void)fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+    }
+#endif
+
+    bool ok = write_all(fd, data, size, done);
+
+#ifdef O_DIRECT
+    // A refused direct write may have left padding behind the end.
+    if (ok && direct && done < size)
+        ok = (ftruncate(fd, (off_t)size) == 0);
+#endif
+
+    if (close(fd) != 0)
+        ok = false;
+
+    return ok ? size : 0;
+#endif
+}
+
+/*
+ * Writes size bytes found at offset in the mapping to filename without
+ * passing them through user space: copy_file_range(), then sendfile() where
+ * the file systems refuse it, and a plain write from the mapping for what
+ * is left. Direct I/O and systems without either call write from the
+ * mapping. Returns the number of bytes written, 0 on failure.
+ */
+size_t
+write_output_copy(const char *filename, const mapping_T *map, const uint64_t offset, const size_t size, const int flags)
+{
+    const char *data = map_range(map, offset, size);
+    if (!filename || !data || size <= 0) return 0;
+
+#ifdef __linux__
+    if (map->fd < 0 || (flags & WRITE_DIRECT))
+        return write_output(filename, data, size, flags);
+
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return 0;
+
+    if (flags & WRITE_PREALLOCATE)
+        (void)fallocate(fd, 0, 0, (off_t)size);
+
+    // The window of an APK member starts inside the file.
+    off_t in = (off_t)((uint64_t)(map->data - map->base) + offset);
+    size_t done = 0;
+
+    while (done < size)
+    {
+        ssize_t ret = copy_file_range(map->fd, &in, fd, NULL, size - done, 0);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) break;
+
+        done += (size_t)ret;
+    }
+
+    while (done < size)
+    {
+        ssize_t ret = sendfile(fd, map->fd, &in, size - done);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret <= 0) break;
+
+        done += (size_t)ret;
+    }
+
+    bool ok = write_all(fd, data, size, done);
+
+    if (close(fd) != 0)
+        ok = false;
+
+    return ok ? size : 0;
+#else
+    return write_output(filename, data, size, flags);
+#endif
+}
+
+/*
+ * Locking for state shared between pool workers. Without threads the pool
+ * runs on the calling thread and these do nothing.
+ */
+#ifndef _WIN32
+typedef pthread_mutex_t mutex_T;
+#define mutex_init(m) pthread_mutex_init((m), NULL)
+#define mutex_lock(m) pthread_mutex_lock(m)
+#define mutex_unlock(m) pthread_mutex_unlock(m)
+#define mutex_destroy(m) pthread_mutex_destroy(m)
+#else
+typedef int mutex_T;
+#define mutex_init(m) ((void)(m))
+#define mutex_lock(m) ((void)(m))
+#define mutex_unlock(m) ((void)(m))
+#define mutex_destroy(m) ((void)(m))
+#endif
+
+/*
+ * Worker pool with work stealing. Each worker starts with an even share of
+ * [0, count) and takes items from the front of its own range; once that is
+ * empty it steals the back half of another worker's range. Items are
+ * independent, callers index their results by item so no merge step is
+ * needed to keep the original order.
+ */
+typedef void (*work_fn_T)(void *ctx, const size_t index, const size_t worker);
+
+#ifndef _WIN32
+typedef struct {
+    pthread_mutex_t lock;
+    size_t begin;
+    size_t end;
+} work_range_T;
+
+typedef struct {
+    work_range_T *ranges;
+    size_t workers;
+    work_fn_T fn;
+    void *ctx;
+} pool_T;
+
+typedef struct {
+    pool_T *pool;
+    size_t self;
+} worker_T;
+
+bool
+pool_next(pool_T *pool, const size_t self, size_t *index)
+{
+    work_range_T *own = &pool->ranges[self];
+
+    pthread_mutex_lock(&own->lock);
+    if (own->begin < own->end)
+    {
+        *index = own->begin++;
+        pthread_mutex_unlock(&own->lock);
+        return true;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (size_t k = 1; k < pool->workers; k++)
+    {
+        work_range_T *victim = &pool->ranges[(self + k) % pool->workers];
+
+        pthread_mutex_lock(&victim->lock);
+        const size_t remaining = victim->end - victim->begin;
+        if (remaining > 0)
+        {
+            const size_t steal = (remaining + 1) / 2;
+            const size_t begin = victim->end - steal;
+            victim->end = begin;
+            pthread_mutex_unlock(&victim->lock);
+
+            pthread_mutex_lock(&own->lock);
+            own->begin = begin + 1;
+            own->end = begin + steal;
+            pthread_mutex_unlock(&own->lock);
+
+            *index = begin;
+            return true;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+
+    return false;
+}
+
+void *
+pool_worker(void *arg)
+{
+    worker_T *worker = arg;
+    size_t index = 0;
+
+    while (pool_next(worker->pool, worker->self, &index))
+        worker->pool->fn(worker->pool->ctx, index, worker->self);
+
+    return NULL;
+}
+#endif
+
+/*
+ * Runs fn over [0, count) on up to jobs threads and returns the number of
+ * workers used. Falls back to the calling thread when jobs <= 1 or threads
+ * are not available.
+ */
+size_t
+run_parallel(const size_t count, const unsigned int jobs, work_fn_T fn, void *ctx)
+{
+    if (!count || !fn) return 0;
+
+#ifndef _WIN32
+    size_t workers = (jobs > count) ? count : jobs;
+
+    if (workers > 1)
+    {
+        work_range_T *ranges = calloc(workers, sizeof(work_range_T));
+        pthread_t *threads = calloc(workers, sizeof(pthread_t));
+        worker_T *args = calloc(workers, sizeof(worker_T));
+
+        if (ranges && threads && args)
+        {
+            pool_T pool = { ranges, workers, fn, ctx };
+
+            for (size_t i = 0; i < workers; i++)
+            {
+                pthread_mutex_init(&ranges[i].lock, NULL);
+                ranges[i].begin = (count * i) / workers;
+                ranges[i].end = (count * (i + 1)) / workers;
+                args[i].pool = &pool;
+                args[i].self = i;
+            }
+
+            size_t started = 1;
+            for (size_t i = 1; i < workers; i++)
+            {
+                if (pthread_create(&threads[i], NULL, pool_worker, &args[i]) != 0)
+                {
+                    // The remaining ranges get stolen by the running workers.
+                    fprintf(stderr, "pthread_create() failed file:%s:%d\n", __FILE__, __LINE__);
+                    break;
+                }
+                started++;
+            }
+
+            pool_worker(&args[0]);
+
+            for (size_t i = 1; i < started; i++)
+                pthread_join(threads[i], NULL);
+
+            for (size_t i = 0; i < workers; i++)
+                pthread_mutex_destroy(&ranges[i].lock);
+
+            free(ranges);
+            free(threads);
+            free(args);
+
+            return started;
+        }
+
+        free(ranges);
+        free(threads);
+        free(args);
+    }
+#else
+    (void)jobs;
+#endif
+
+    for (size_t i = 0; i < count; i++)
+        fn(ctx, i, 0);
+
+    return 1;
+}
+
+/*
+ * xxHash32 and xxHash64, the hashes the runtime indexes assembly names with.
+ */
+#define XXH_PRIME32_1 0x9E3779B1U
+#define XXH_PRIME32_2 0x85EBCA77U
+#define XXH_PRIME32_3 0xC2B2AE3DU
+#define XXH_PRIME32_4 0x27D4EB2FU
+#define XXH_PRIME32_5 0x165667B1U
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define XXH_ROTL32(x, r) (((x) << (r)) | ((x) >> (32 - (r))))
+#define XXH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+uint32_t
+xxh_read32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t
+xxh_read64(const uint8_t *p)
+{
+    return (uint64_t)xxh_read32(p) | ((uint64_t)xxh_read32(p + 4) << 32);
+}
+
+uint32_t
+xxh32_round(uint32_t acc, const uint32_t input)
+{
+    acc += input * XXH_PRIME32_2;
+    acc = XXH_ROTL32(acc, 13);
+    return acc * XXH_PRIME32_1;
+}
+
+uint32_t
+xxh32(const void *data, const size_t len, const uint32_t seed)
+{
+    const uint8_t *p = data;
+    const uint8_t *end = p + len;
+    uint32_t h;
+
+    if (len >= 16)
+    {
+        uint32_t v1 = seed + XXH_PRIME32_1 + XXH_PRIME32_2;
+        uint32_t v2 = seed + XXH_PRIME32_2;
+        uint32_t v3 = seed;
+        uint32_t v4 = seed - XXH_PRIME32_1;
+
+        for (; p + 16 <= end; p += 16)
+        {
+            v1 = xxh32_round(v1, xxh_read32(p));
+            v2 = xxh32_round(v2, xxh_read32(p + 4));
+            v3 = xxh32_round(v3, xxh_read32(p + 8));
+            v4 = xxh32_round(v4, xxh_read32(p + 12));
+        }
+
+        h = XXH_ROTL32(v1, 1) + XXH_ROTL32(v2, 7) + XXH_ROTL32(v3, 12) + XXH_ROTL32(v4, 18);
+    }
+    else
+        h = seed + XXH_PRIME32_5;
+
+    h += (uint32_t)len;
+
+    for (; p + 4 <= end; p += 4)
+    {
+        h += xxh_read32(p) * XXH_PRIME32_3;
+        h = XXH_ROTL32(h, 17) * XXH_PRIME32_4;
+    }
+
+    for (; p < end; p++)
+    {
+        h += (*p) * XXH_PRIME32_5;
+        h = XXH_ROTL32(h, 11) * XXH_PRIME32_1;
+    }
+
+    h ^= h >> 15;
+    h *= XXH_PRIME32_2;
+    h ^= h >> 13;
+    h *= XXH_PRIME32_3;
+    h ^= h >> 16;
+
+    return h;
+}
+
+uint64_t
+xxh64_round(uint64_t acc, const uint64_t input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc = XXH_ROTL64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+uint64_t
+xxh64_merge(uint64_t acc, const uint64_t val)
+{
+    acc ^= xxh64_round(0, val);
+    return (acc * XXH_PRIME64_1) + XXH_PRIME64_4;
+}
+
+uint64_t
+xxh64(const void *data, const size_t len, const uint64_t seed)
+{
+    const uint8_t *p = data;
+    const uint8_t *end = p + len;
+    uint64_t h;
+
+    if (len >= 32)
+    {
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+
+        for (; p + 32 <= end; p += 32)
+        {
+            v1 = xxh64_round(v1, xxh_read64(p));
+            v2 = xxh64_round(v2, xxh_read64(p + 8));
+            v3 = xxh64_round(v3, xxh_read64(p + 16));
+            v4 = xxh64_round(v4, xxh_read64(p + 24));
+        }
+
+        h = XXH_ROTL64(v1, 1) + XXH_ROTL64(v2, 7) + XXH_ROTL64(v3, 12) + XXH_ROTL64(v4, 18);
+        h = xxh64_merge(h, v1);
+        h = xxh64_merge(h, v2);
+        h = xxh64_merge(h, v3);
+        h = xxh64_merge(h, v4);
+    }
+    else
+        h = seed + XXH_PRIME64_5;
+
+    h += (uint64_t)len;
+
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= xxh64_round(0, xxh_read64(p));
+        h = (XXH_ROTL64(h, 27) * XXH_PRIME64_1) + XXH_PRIME64_4;
+    }
+
+    if (p + 4 <= end)
+    {
+        h ^= (uint64_t)xxh_read32(p) * XXH_PRIME64_1;
+        h = (XXH_ROTL64(h, 23) * XXH_PRIME64_2) + XXH_PRIME64_3;
+        p += 4;
+    }
+
+    for (; p < end; p++)
+    {
+        h ^= (*p) * XXH_PRIME64_5;
+        h = XXH_ROTL64(h, 11) * XXH_PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+/*
+ * SHA-256 (FIPS 180-4), for content store keys that must not collide.
+ */
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_ROTR(x, r) (((x) >> (r)) | ((x) << (32 - (r))))
+
+void
+sha256_block(uint32_t *state, const uint8_t *block)
+{
+    uint32_t w[64];
+
+    for (int i = 0; i < 16; i++)
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[(i * 4) + 1] << 16)
+            | ((uint32_t)block[(i * 4) + 2] << 8) | (uint32_t)block[(i * 4) + 3];
+
+    for (int i = 16; i < 64; i++)
+    {
+        const uint32_t s0 = SHA256_ROTR(w[i - 15], 7) ^ SHA256_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const uint32_t s1 = SHA256_ROTR(w[i - 2], 17) ^ SHA256_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; i++)
+    {
+        const uint32_t t1 = h + (SHA256_ROTR(e, 6) ^ SHA256_ROTR(e, 11) ^ SHA256_ROTR(e, 25))
+            + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        const uint32_t t2 = (SHA256_ROTR(a, 2) ^ SHA256_ROTR(a, 13) ^ SHA256_ROTR(a, 22))
+            + ((a & b) ^ (a & c) ^ (b & c));
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void
+sha256(const void *data, const size_t len, uint8_t *digest)
+{
+    uint32_t state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    const uint8_t *p = data;
+    size_t left = len;
+
+    for (; left >= 64; p += 64, left -= 64)
+        sha256_block(state, p);
+
+    // The tail, the 0x80 marker and the bit length fill one or two blocks.
+    uint8_t tail[128] = { 0 };
+    memcpy(tail, p, left);
+    tail[left] = 0x80;
+
+    const size_t tail_size = (left < 56) ? 64 : 128;
+    const uint64_t bits = (uint64_t)len * 8;
+    for (int i = 0; i < 8; i++)
+        tail[tail_size - 1 - i] = (uint8_t)(bits >> (i * 8));
+
+    for (size_t off = 0; off < tail_size; off += 64)
+        sha256_block(state, tail + off);
+
+    for (int i = 0; i < 8; i++)
+    {
+        digest[i * 4] = (uint8_t)(state[i] >> 24);
+        digest[(i * 4) + 1] = (uint8_t)(state[i] >> 16);
+        digest[(i * 4) + 2] = (uint8_t)(state[i] >> 8);
+        digest[(i * 4) + 3] = (uint8_t)state[i];
+    }
+}
+
+/*
+ * Content store keys: 16 hex digits of xxh64 or 64 of SHA-256.
+ */
+#define CAS_KEY_SIZE 64
+
+/*
+ * Size of the object path buffer of a store rooted at cas.
+ */
+size_t
+cas_path_size(const char *cas)
+{
+    return strlen(cas) + sizeof("/aa/") + CAS_KEY_SIZE;
+}
+
+/*
+ * Writes <cas>/<aa>/<key> for the payload into path, sized by
+ * cas_path_size(), and returns the part relative to the root.
+ */
+const char*
+cas_object(char *path, const char *cas, const uint8_t *data, const size_t size, const bool sha)
+{
+    char key[CAS_KEY_SIZE + 1];
+
+    if (sha)
+    {
+        uint8_t digest[32];
+        sha256(data, size, digest);
+
+        for (size_t i = 0; i < sizeof(digest); i++)
+            snprintf(key + (i * 2), 3, "%02x", digest[i]);
+    }
+    else
+        snprintf(key, sizeof(key), "%016" PRIx64, xxh64(data, size, 0));
+
+    const size_t root_len = strlen(cas);
+    snprintf(path, cas_path_size(cas), "%s/%.2s/%s", cas, key, key);
+
+    return path + root_len + 1;
+}
+
+/*
+ * Stores a payload under its object path unless it is already there. The
+ * object is written to a temporary name next to it and renamed into place,
+ * so concurrent writers and readers never see a partial object. Returns 1
+ * when written, 0 when the store already had it and -1 on failure.
+ */
+int
+cas_store(const char *path, const uint8_t *data, const size_t size, const int flags)
+{
+    struct stat st;
+    if (stat(path, &st) == 0)
+        return 0;
+
+    // The <aa> directory, the root exists already.
+    const size_t len = strlen(path);
+    char *tmp = malloc(len + 64);
+    if (!tmp) return -1;
+
+    const char *slash = strrchr(path, '/');
+    memcpy(tmp, path, (size_t)(slash - path));
+    tmp[slash - path] = '\0';
+
+#ifdef _WIN32
+    if (_mkdir(tmp) < 0 && errno != EEXIST)
+#else
+    if (mkdir(tmp, 0755) < 0 && errno != EEXIST)
+#endif
+    {
+        fprintf(stderr, "mkdir() failed for %s: %s\n", tmp, strerror(errno));
+        free(tmp);
+        return -1;
+    }
+
+    // The payload address tells apart writers of the same object in this
+    // process, the pid writers in other processes.
+#ifdef _WIN32
+    snprintf(tmp, len + 64, "%s.%d.%p.tmp", path, _getpid(), (const void*)data);
+#else
+    snprintf(tmp, len + 64, "%s.%d.%p.tmp", path, (int)getpid(), (const void*)data);
+#endif
+
+    int ret = -1;
+    if (write_output(tmp, (const char*)data, size, flags) == size)
+    {
+        if (rename(tmp, path) == 0)
+            ret = 1;
+        else if (stat(path, &st) == 0)
+            ret = 0;
+    }
+
+    if (ret != 1)
+        remove(tmp);
+
+    free(tmp);
+
+    return ret;
+}
+
+/*
+ * Creates an extracted file from its object. By default the file is its own
+ * copy, so editing it cannot alter the store: a reflink (FICLONE) where the
+ * file system shares extents, a plain write otherwise. With hardlink the
+ * file is the object itself, falling back to a copy where the file system
+ * cannot link.
+ */
+bool
+cas_link(const char *object, const char *output, const uint8_t *data, const size_t size, const int flags, const bool hardlink)
+{
+#ifndef _WIN32
+    (void)unlink(output);
+
+    if (hardlink && link(object, output) == 0)
+        return true;
+#else
+    (void)object;
+    (void)hardlink;
+#endif
+
+#if defined(__linux__) && defined(FICLONE)
+    if (!hardlink && !(flags & WRITE_DIRECT))
+    {
+        const int in = open(object, O_RDONLY | O_CLOEXEC);
+        const int out = (in >= 0) ? open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : -1;
+        const bool cloned = out >= 0 && ioctl(out, FICLONE, in) == 0;
+
+        if (out >= 0) close(out);
+        if (in >= 0) close(in);
+
+        if (cloned)
+            return true;
+    }
+#endif
+
+    return write_output(output, (const char*)data, size, flags) == size;
+}
+
+/*
+ * Entries whose name is not in the manifest are reported as 0x<hash32>.dll,
+ * the name lives in the arena next to the manifest names.
+ */
+const char*
+hash_name(block_T *block, const uint32_t hash32)
+{
+    char *name = block_alloc(block, sizeof("0x00000000.dll"));
+    if (!name) return NULL;
+
+    sprintf(name, "0x%x.dll", hash32);
+
+    return name;
+}
+
+/*
+ * Validates the header and the descriptor table of one store file.
+ */
+int
+store_file_load(store_file_T *file, const char *path)
+{
+    if (read_header(&file->map, &file->header) < 0)
+    {
+        fprintf(stderr, "Failed reading file\n");
+        return -1;
+    }
+
+    if (file->header.magic != XABA_MAGIC)
+    {
+        fprintf(stderr, "%s is not a AssemblyStore File\n", path);
+        return -1;
+    }
+
+    if (file->header.entry_count <= 0)
+    {
+        fprintf(stderr, "received a non-valid entry count\n");
+        return -1;
+    }
+
+    // Descriptors are used in place from the mapping.
+    file->descriptors = map_range(
+            &file->map,
+            sizeof(header_T),
+            (uint64_t)file->header.entry_count * sizeof(descriptor_T));
+    if (!file->descriptors)
+    {
+        fprintf(stderr, "descriptor table out of bounds: %s:%d\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    if (is_debug)
+    {
+        fprintf(stdout, "magic: 0x%X, version: 0x%u, entries: %u, index_entries: %u, store_id: %u \n",
+                file->header.magic, file->header.version, file->header.entry_count,
+                file->header.index_entry_count, file->header.store_id);
+    }
+
+    return 0;
+}
+
+/*
+ * Per-ABI stores are named <stem>.<abi>.blob next to <stem>.blob. Copies the
+ * ABI of name into abi when it is one of them.
+ */
+bool
+store_sibling_abi(const char *name, const size_t len, const char *stem, const size_t stem_len, char *abi)
+{
+    const size_t ext = sizeof(".blob") - 1;
+
+    if (len <= stem_len + 1 + ext || memcmp(name, stem, stem_len) != 0 || name[stem_len] != '.')
+        return false;
+
+    if (memcmp(name + len - ext, ".blob", ext) != 0)
+        return false;
+
+    const char *begin = name + stem_len + 1;
+    const size_t abi_len = (size_t)((name + len - ext) - begin);
+
+    if (!abi_len || abi_len >= STORE_ABI_SIZE || memchr(begin, '.', abi_len))
+        return false;
+
+    memcpy(abi, begin, abi_len);
+    abi[abi_len] = '\0';
+
+    return true;
+}
+
+int
+compare_store_files(const void *a, const void *b)
+{
+    return strcmp(((const store_file_T*)a)->abi, ((const store_file_T*)b)->abi);
+}
+
+/*
+ * Returns a zeroed slot past the *count loaded files of a store set, growing
+ * the array when it is full. NULL once the set holds STORE_MAX_FILES files.
+ */
+store_file_T*
+store_files_slot(store_file_T **files, const size_t count, size_t *capacity, const char *name)
+{
+    if (count >= STORE_MAX_FILES)
+    {
+        fprintf(stderr, "skipping store %s: more than %d stores in the set\n", name, STORE_MAX_FILES);
+        return NULL;
+    }
+
+    if (count == *capacity)
+    {
+        const size_t grown = *capacity * 2;
+        store_file_T *resized = realloc(*files, grown * sizeof(store_file_T));
+        if (!resized)
+        {
+            fprintf(stderr, "realloc() failed file:%s:%d\n", __FILE__, __LINE__);
+            return NULL;
+        }
+
+        *files = resized;
+        *capacity = grown;
+    }
+
+    memset(&(*files)[count], 0, sizeof(store_file_T));
+    return &(*files)[count];
+}
+
+/*
+ * Adds the per-ABI stores that are members of the same APK/AAB as the
+ * primary store. They are windows of the archive mapping owned by files[0].
+ */
+void
+store_siblings_zip(const mapping_T *archive, const zip_entry_T *primary, store_file_T **files, size_t *count, size_t *capacity)
+{
+    // Split "dir/stem.blob" into the member directory and the stem.
+    size_t dir_len = primary->name_len;
+    while (dir_len && primary->name[dir_len - 1] != '/')
+        dir_len--;
+
+    const char *stem = primary->name + dir_len;
+    const size_t stem_len = primary->name_len - dir_len - (sizeof(".blob") - 1);
+
+    zip_iter_T iter;
+    if (zip_iter_init(archive, &iter) < 0) return;
+
+    const uint8_t *record = NULL;
+    while (zip_iter_next(&iter, &record) > 0)
+    {
+        const char *name = (const char*)record + ZIP_CENTRAL_SIZE;
+        const size_t len = read_u16(record + 28);
+        char abi[STORE_ABI_SIZE];
+
+        if (len <= dir_len || memcmp(name, primary->name, dir_len) != 0)
+            continue;
+
+        if (!store_sibling_abi(name + dir_len, len - dir_len, stem, stem_len, abi))
+            continue;
+
+        zip_entry_T member = { 0 };
+        if (zip_member(archive, record, &member) < 0 || member.method != ZIP_METHOD_STORED)
+        {
+            fprintf(stderr, "skipping store %.*s: compressed or malformed member\n", (int)len, name);
+            continue;
+        }
+
+        store_file_T *file = store_files_slot(files, *count, capacity, abi);
+        if (!file) break;
+
+        memcpy(file->abi, abi, sizeof(abi));
+        file->map = *archive;
+        file->map.data += member.offset;
+        file->map.size = (size_t)member.size;
+        file->owns_map = false;
+
+        if (store_file_load(file, file->abi) == 0)
+            (*count)++;
+    }
+}
+
+/*
+ * Adds the per-ABI stores found next to the primary store on disk.
+ */
+void
+store_siblings_dir(const char *path, store_file_T **files, size_t *count, size_t *capacity)
+{
+#ifndef _WIN32
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+
+    const size_t base_len = strlen(base);
+    const size_t ext = sizeof(".blob") - 1;
+    if (base_len <= ext || strcmp(base + base_len - ext, ".blob") != 0)
+        return;
+
+    const size_t dir_len = (size_t)(base - path);
+    const size_t stem_len = base_len - ext;
+
+    char *dir_path = malloc(dir_len + 2);
+    if (!dir_path) return;
+
+    if (dir_len)
+    {
+        memcpy(dir_path, path, dir_len);
+        dir_path[dir_len] = '\0';
+    }
+    else
+        strcpy(dir_path, ".");
+
+    DIR *dir = opendir(dir_path);
+    free(dir_path);
+    if (!dir) return;
+
+    struct dirent *ent = NULL;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        char abi[STORE_ABI_SIZE];
+
+        if (!store_sibling_abi(ent->d_name, strlen(ent->d_name), base, stem_len, abi))
+            continue;
+
+        store_file_T *file = store_files_slot(files, *count, capacity, ent->d_name);
+        if (!file) break;
+
+        memcpy(file->abi, abi, sizeof(abi));
+
+        char *sibling = malloc(dir_len + strlen(ent->d_name) + 1);
+        if (!sibling) break;
+
+        memcpy(sibling, path, dir_len);
+        strcpy(sibling + dir_len, ent->d_name);
+
+        if (map_file(sibling, &file->map) == 0)
+        {
+            file->owns_map = true;
+
+            if (store_file_load(file, sibling) == 0)
+                (*count)++;
+            else
+                unmap_file(&file->map);
+        }
+
+        free(sibling);
+    }
+
+    closedir(dir);
+#else
+    (void)path;
+    (void)files;
+    (void)count;
+    (void)capacity;
+#endif
+}
+
+void
+store_files_close(store_file_T *files, const size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (files[i].owns_map)
+            unmap_file(&files[i].map);
+    }
+}
+
+/*
+ * Identity of a store set for the decode cache: xxh64 over the header,
+ * descriptors and ABI of every file, seeded with the file size, over the
+ * index of the primary store and over the manifest that names the entries.
+ */
+uint64_t
+store_fingerprint(
+        const store_file_T *files,
+        const size_t file_count,
+        const size_t index_count,
+        const char *manifest,
+        const size_t manifest_size)
+{
+    uint64_t hash = 0;
+
+    for (size_t f = 0; f < file_count; f++)
+    {
+        const store_file_T *file = &files[f];
+        size_t size = sizeof(header_T) + ((size_t)file->header.entry_count * sizeof(descriptor_T));
+
+        if (f == 0)
+            size += index_count * sizeof(hash_T) * 2;
+
+        // The primary store's tables were bounds checked before, the ABI
+        // stores only have their descriptors.
+        const void *tables = map_range(&file->map, 0, size);
+
+        hash = xxh64(tables ? tables : file->map.data, tables ? size : 0, hash ^ file->map.size);
+        hash = xxh64(file->abi, strlen(file->abi), hash);
+    }
+
+    return xxh64(manifest, manifest ? manifest_size : 0, hash);
+}
+
+/*
+ * Writes <cache>/<fingerprint>.dabc into a malloc()ed buffer, with room for
+ * the suffix of a temporary name.
+ */
+char*
+cache_path(const char *cache, const uint64_t fingerprint)
+{
+    const size_t size = strlen(cache) + sizeof("/0123456789abcdef.dabc") + 64;
+    char *path = malloc(size);
+
+    if (path)
+        snprintf(path, size, "%s/%016" PRIx64 ".dabc", cache, fingerprint);
+
+    return path;
+}
+
+/*
+ * Maps the cache file of a store set and checks it against the set: the
+ * fingerprint, one record per entry slot in the order store_open() lays them
+ * out, names and payloads within the file. Returns the records, or NULL
+ * with the map released when there is no usable cache file.
+ */
+const cache_entry_T*
+cache_load(
+        mapping_T *map,
+        const char *cache,
+        const uint64_t fingerprint,
+        const uint64_t blob_size,
+        const store_file_T *files,
+        const size_t file_count,
+        const hash_T *hashes,
+        const size_t count)
+{
+    char *path = cache_path(cache, fingerprint);
+    if (!path || map_file(path, map) < 0)
+    {
+        free(path);
+        return NULL;
+    }
+
+    free(path);
+
+    cache_header_T header = { 0 };
+    const cache_header_T *header_ptr = map_range(map, 0, sizeof(cache_header_T));
+    if (header_ptr)
+        memcpy(&header, header_ptr, sizeof(cache_header_T));
+
+    const uint64_t records_size = (uint64_t)header.entry_count * sizeof(cache_entry_T);
+    const cache_entry_T *records = map_range(map, sizeof(cache_header_T), records_size);
+    const char *strings = map_range(map, sizeof(cache_header_T) + records_size, header.strings_size);
+
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.fingerprint != fingerprint
+            || header.blob_size != blob_size || !records || !strings || !header.strings_size
+            || strings[header.strings_size - 1] != '\0')
+        goto FAIL;
+
+    size_t slot = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const hash_T *hash = get_hash(hashes, count, i);
+        const size_t first = slot;
+
+        for (size_t f = 0; f <= file_count; f++)
+        {
+            // The last round stands for an index slot no file holds.
+            if (f == file_count ? (slot != first) : (files[f].header.store_id != hash->store_id))
+                continue;
+
+            if (slot >= header.entry_count)
+                goto FAIL;
+
+            const cache_entry_T *record = &records[slot++];
+
+            if (record->index != hash->local_store_index || record->hash32 != hash->hash32
+                    || (f < file_count && record->file != f) || record->name_offset >= header.strings_size
+                    || record->name_len != strlen(strings + record->name_offset)
+                    || record->state > ENTRY_INVALID)
+                goto FAIL;
+
+            if (record->payload_offset && (record->state != ENTRY_VALID
+                        || !map_range(map, record->payload_offset, record->size)))
+                goto FAIL;
+        }
+    }
+
+    if (slot != header.entry_count)
+        goto FAIL;
+
+    return records;
+
+FAIL:
+    fprintf(stderr, "ignoring stale decode cache %016" PRIx64 " in %s\n", fingerprint, cache);
+    unmap_file(map);
+
+    return NULL;
+}
+
+/*
+ * Maps the primary store and its per-ABI siblings, validates the headers and
+ * the tables and builds the entry metadata. The arena is created in *block,
+ * sized for the payloads as well when the caller is going to decode
+ * everything. With a cache directory the entry metadata of a store set seen
+ * before is read back from its cache file, which then stays mapped.
+ */
+dabu_T*
+store_open(block_T **block, const char *path, const bool with_payloads, dump_stats_T *stats, const char *cache)
+{
+    double start = now_seconds();
+
+    if (path == NULL || *path == '\0' || strlen(path) <= 0)
+    {
+	fprintf(stderr, "received invalid parameter\n");
+        return NULL;
+    }
+
+    // Grown as sibling stores are found, the primary store is files[0].
+    size_t file_capacity = 4;
+    store_file_T *files = calloc(file_capacity, sizeof(store_file_T));
+    if (!files)
+    {
+        fprintf(stderr, "calloc() failed file:%s:%d\n", __FILE__, __LINE__);
+        return NULL;
+    }
+
+    size_t file_count = 1;
+    store_file_T *primary = &files[0];
+    mapping_T manifest_map = { 0 };
+    mapping_T cache_map = { 0 };
+    const cache_entry_T *cached = NULL;
+
+    if (map_file(path, &primary->map) < 0)
+    {
+        fprintf(stderr, "Failed opening assemblies blob file\n");
+        free(files);
+		return NULL;
+    }
+    primary->owns_map = true;
+
+    // An APK or AAB is parsed in place, nothing is extracted first.
+    const char *archive_manifest = NULL;
+    size_t archive_manifest_size = 0;
+    const mapping_T archive = primary->map;
+    const bool in_archive = zip_is_archive(&archive);
+    zip_entry_T member = { 0 };
+
+    if (in_archive && zip_open_store(&primary->map, path, &archive_manifest, &archive_manifest_size, &member) < 0)
+        goto FAIL;
+
+    if (store_file_load(primary, path) < 0)
+        goto FAIL;
+
+    const size_t count = primary->header.index_entry_count;
+    if (count <= 0)
+    {
+        fprintf(stderr, "received a non-valid index entry count, %s is not a primary store\n", path);
+		goto FAIL;
+    }
+
+    size_t fpos = sizeof(header_T) + ((size_t)primary->header.entry_count * sizeof(descriptor_T));
+
+    // Both hash tables are used in place from the mapping.
+    const hash_T *hash32list = map_range(&primary->map, fpos, (uint64_t)count * sizeof(hash_T));
+    if(hash32list == NULL)
+    {
+	    fprintf(stderr, "hash32 table out of bounds file:%s:%d\n", __FILE__, __LINE__);
+            goto FAIL;
+    }
+
+    fpos += count * sizeof(hash_T);
+
+    const hash_T *hash64list = map_range(&primary->map, fpos, (uint64_t)count * sizeof(hash_T));
+    if(hash64list == NULL)
+    {
+	    fprintf(stderr, "hash64 table out of bounds file:%s:%d\n", __FILE__, __LINE__);
+            goto FAIL;
+    }
+
+    // The array may move while siblings are added, primary is not used past here.
+    if (in_archive)
+        store_siblings_zip(&archive, &member, &files, &file_count, &file_capacity);
+    else
+        store_siblings_dir(path, &files, &file_count, &file_capacity);
+
+    // ABI stores are kept in a stable order, the primary store stays first.
+    qsort(files + 1, file_count - 1, sizeof(store_file_T), compare_store_files);
+
+    // Every index slot gets one entry per file holding its store id, or one
+    // invalid entry when no file does.
+    size_t entry_count = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t matches = 0;
+        for (size_t f = 0; f < file_count; f++)
+            matches += (files[f].header.store_id == hash32list[i].store_id);
+
+        entry_count += matches ? matches : 1;
+    }
+
+    // The manifest is part of the fingerprint. It is parsed once the arena
+    // exists, and only when the cache does not name the entries.
+    const char *manifest_text = archive_manifest;
+    size_t manifest_size = archive_manifest_size;
+    if (!in_archive && manifest_load(path, &manifest_map) == 0)
+    {
+        manifest_text = (const char*)manifest_map.data;
+        manifest_size = manifest_map.size;
+    }
+
+    uint64_t fingerprint = 0;
+    uint64_t blob_size = 0;
+    if (cache)
+    {
+        for (size_t f = 0; f < file_count; f++)
+            blob_size += files[f].map.size;
+
+        fingerprint = store_fingerprint(files, file_count, count, manifest_text, manifest_size);
+        cached = cache_load(&cache_map, cache, fingerprint, blob_size, files, file_count, hash32list, count);
+    }
+
+    if (stats)
+    {
+        stats->table_seconds += now_seconds() - start;
+        stats->entries += count;
+        start = now_seconds();
+    }
+
+    // Every payload is about to be read: the readahead of all files starts
+    // before the plan walks the XALZ headers.
+    for (size_t f = 0; with_payloads && !cached && f < file_count; f++)
+        map_advise(&files[f].map, 0, files[f].map.size, ADVISE_WILLNEED);
+
+    // With payloads the plan reads every XALZ header, it counts as payload I/O.
+    const cache_header_T *cache_header = cached ? (const cache_header_T*)cache_map.data : NULL;
+    const size_t plan = plan_arena_size(files, file_count, hash32list, count, strlen(path), with_payloads, cached)
+        + (cache_header ? (size_t)cache_header->strings_size : 0);
+
+    // A block left over from a previous blob is reset and reused.
+    if (*block)
+    {
+        block_reset(*block);
+
+        if (block_reserve(*block, plan) < 0)
+        {
+            fprintf(stderr, "block_reserve() failed\n");
+            goto FAIL;
+        }
+    }
+    else
+        *block = block_create(plan);
+
+    if (!*block)
+    {
+        fprintf(stderr, "block_create() failed\n");
+		goto FAIL;
+    }
+
+    if (stats)
+    {
+        stats->io_seconds += now_seconds() - start;
+        start = now_seconds();
+    }
+
+    dabu_T *store = block_alloc(*block, sizeof(dabu_T));
+    if (!store)
+    {
+        fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+        goto FAIL;
+    }
+
+    memset(store, 0, sizeof(dabu_T));
+    store->block = *block;
+    store->hash32list = hash32list;
+    store->hash64list = hash64list;
+    store->index_count = count;
+    store->count = entry_count;
+    store->path = path;
+    store->cache_dir = cache;
+    store->fingerprint = fingerprint;
+    store->blob_size = blob_size;
+
+    store->files = block_alloc(*block, file_count * sizeof(store_file_T));
+    store->entries = block_alloc(*block, entry_count * sizeof(assembly_entry_T));
+    store->state = block_alloc(*block, entry_count * sizeof(uint8_t));
+    store->file_of = block_alloc(*block, entry_count * sizeof(uint8_t));
+
+    if (!store->files || !store->entries || !store->state || !store->file_of)
+    {
+        fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+        goto FAIL;
+    }
+
+    memcpy(store->files, files, file_count * sizeof(store_file_T));
+    store->file_count = file_count;
+
+    memset(store->entries, 0, entry_count * sizeof(assembly_entry_T));
+    memset(store->state, ENTRY_UNRESOLVED, entry_count * sizeof(uint8_t));
+    memset(store->file_of, 0, entry_count * sizeof(uint8_t));
+
+    // hash32list drives the walk, hash64 values are looked up by descriptor.
+    uint64_t **hash64s = block_alloc(*block, file_count * sizeof(uint64_t*));
+    if (!hash64s)
+    {
+        fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+        goto FAIL;
+    }
+
+    for (size_t f = 0; f < file_count; f++)
+    {
+        store_file_T *file = &store->files[f];
+        const size_t n = file->header.entry_count;
+
+        // Descriptor index to entry slot + 1, for lookups through hash64list.
+        hash64s[f] = block_alloc(*block, n * sizeof(uint64_t));
+        file->by_descriptor = block_alloc(*block, n * sizeof(uint32_t));
+
+        if (!hash64s[f] || !file->by_descriptor)
+        {
+            fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+            goto FAIL;
+        }
+
+        memset(hash64s[f], 0, n * sizeof(uint64_t));
+        memset(file->by_descriptor, 0, n * sizeof(uint32_t));
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (hash64list[i].store_id == file->header.store_id && hash64list[i].local_store_index < n)
+                hash64s[f][hash64list[i].local_store_index] = hash64list[i].hash64;
+        }
+    }
+
+    // Cached names are copied so that they outlive the cache mapping.
+    char *names = NULL;
+    if (cached)
+    {
+        names = block_alloc(*block, cache_header->strings_size);
+        if (!names)
+        {
+            fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+            goto FAIL;
+        }
+
+        memcpy(names, (const char*)(cached + entry_count), cache_header->strings_size);
+    }
+    else if (manifest_text)
+    {
+        if (manifest_parse(*block, manifest_text, manifest_size, &store->manifest) < 0)
+            fprintf(stderr, "Failed parsing manifest\n");
+    }
+    else if (!in_archive)
+        fprintf(stderr, "Failed opening manifest file\n");
+
+    unmap_file(&manifest_map);
+
+    size_t slot = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const hash_T* hash = get_hash(hash32list, count, i);
+
+        const char* dllname = cached ? names + cached[slot].name_offset : manifest_find32(&store->manifest, hash->hash32);
+
+        if (!dllname)
+            dllname = hash_name(*block, hash->hash32);
+
+        if (!dllname)
+        {
+            fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+            goto FAIL;
+        }
+
+        const size_t first = slot;
+
+        for (size_t f = 0; f < file_count; f++)
+        {
+            store_file_T *file = &store->files[f];
+            if (file->header.store_id != hash->store_id)
+                continue;
+
+            assembly_entry_T *entry = &store->entries[slot];
+            entry->name = dllname;
+            entry->name_len = (uint32_t)strlen(dllname);
+            entry->index = hash->local_store_index;
+            entry->hash32 = hash->hash32;
+            entry->store_id = hash->store_id;
+            entry->abi = file->abi[0] ? file->abi : NULL;
+            store->file_of[slot] = (uint8_t)f;
+
+            const descriptor_T* dsc = get_descriptor(file->descriptors, file->header.entry_count, hash->local_store_index);
+            if (!dsc)
+            {
+                fprintf(stderr, "Failed getting descriptor object for local store index 0x%x\n", hash->local_store_index);
+                store->state[slot++] = ENTRY_INVALID;
+                continue;
+            }
+
+            entry->hash64 = hash64s[f][hash->local_store_index];
+            entry->data_offset = dsc->data_offset;
+            entry->data_size = dsc->data_size;
+            entry->debug_data_offset = dsc->debug_data_offset;
+            entry->debug_data_size = dsc->debug_data_size;
+            entry->config_data_offset = dsc->config_data_offset;
+            entry->config_data_size = dsc->config_data_size;
+
+            // The XALZ header was read when the cache was written, unless
+            // the record is still unresolved.
+            if (cached)
+            {
+                const cache_entry_T *record = &cached[slot];
+                entry->size = record->size;
+                entry->compressed = record->compressed;
+                store->state[slot] = record->state;
+
+                if (record->payload_offset)
+                    entry->data = map_range(&cache_map, record->payload_offset, record->size);
+            }
+
+            if (!file->by_descriptor[hash->local_store_index])
+                file->by_descriptor[hash->local_store_index] = (uint32_t)(slot + 1);
+
+            slot++;
+        }
+
+        if (slot == first)
+        {
+            fprintf(stderr, "no store file with id %u for %s\n", hash->store_id, dllname);
+
+            assembly_entry_T *entry = &store->entries[slot];
+            entry->name = dllname;
+            entry->name_len = (uint32_t)strlen(dllname);
+            entry->index = hash->local_store_index;
+            entry->hash32 = hash->hash32;
+            entry->store_id = hash->store_id;
+            store->state[slot++] = ENTRY_INVALID;
+        }
+    }
+
+    store->cache = cache_map;
+    store->cached = cached;
+
+    if (stats)
+        stats->manifest_seconds += now_seconds() - start;
+
+    free(files);
+    return store;
+
+FAIL:
+    store_files_close(files, file_count);
+    free(files);
+    unmap_file(&manifest_map);
+    unmap_file(&cache_map);
+
+    return NULL;
+}
+
+void
+store_close(dabu_T *store)
+{
+    if (store)
+    {
+        store_files_close(store->files, store->file_count);
+        unmap_file(&store->cache);
+        store->cached = NULL;
+    }
+}
+
+const mapping_T*
+store_map(const dabu_T *store, const size_t index)
+{
+    return &store->files[store->file_of[index]].map;
+}
+
+/*
+ * Reads the XALZ header of an entry to learn its decompressed size. Returns
+ * NULL for entries that cannot be decoded.
+ */
+const assembly_entry_T*
+store_resolve(dabu_T *store, const size_t index)
+{
+    if (!store || index >= store->count) return NULL;
+
+    if (store->state[index] == ENTRY_VALID) return &store->entries[index];
+    if (store->state[index] == ENTRY_INVALID) return NULL;
+
+    assembly_entry_T *entry = &store->entries[index];
+    const store_file_T *file = &store->files[store->file_of[index]];
+    const descriptor_T *dsc = get_descriptor(file->descriptors, file->header.entry_count, entry->index);
+    store->state[index] = ENTRY_INVALID;
+
+    // A stored PE image can be smaller than an XALZ header or end right at
+    // the end of the file, it is recognized before the header is required.
+    const uint8_t *payload = map_range(&file->map, entry->data_offset, entry->data_size);
+    if (payload && payload_is_raw(payload, entry->data_size))
+    {
+        entry->size = entry->data_size;
+        entry->compressed = false;
+        store->state[index] = ENTRY_VALID;
+
+        return entry;
+    }
+
+    xalz_T xalz = { 0 };
+    const xalz_T *xalz_ptr = map_range(&file->map, entry->data_offset, sizeof(xalz_T));
+    if (!xalz_ptr)
+    {
+        fprintf(stderr, "XALZ header out of bounds file:%s:%d\n", __FILE__, __LINE__);
+        return NULL;
+    }
+    memcpy(&xalz, xalz_ptr, sizeof(xalz_T));
+
+    if (is_debug)
+    {
+        fprintf(stdout, "file: %s pos: 0x%x index: %d magic: 0x%x xalz.size: 0x%x data_offset: 0x%x data_size: %d\n",
+                entry->name, entry->data_offset, entry->index, xalz.magic, xalz.size, entry->data_offset, entry->data_size);
+    }
+
+    if (xalz.magic != XALZ_MAGIC)
+    {
+        fprintf(stderr, "Bailing invalid XALZ magic signature found\n");
+        return NULL;
+    }
+
+    if (!xalz_size_valid(&xalz, dsc->data_size))
+    {
+        // Skip extraction of the file
+        fprintf(stderr, "Bailing invalid XALZ payload size value\n");
+        return NULL;
+    }
+
+    if (!map_range(&file->map, entry->data_offset, entry->data_size))
+    {
+        fprintf(stderr, "XALZ payload out of bounds file:%s:%d\n", __FILE__, __LINE__);
+        return NULL;
+    }
+
+    entry->size = xalz.size;
+    entry->compressed = true;
+    store->state[index] = ENTRY_VALID;
+
+    return entry;
+}
+
+/*
+ * A unit of work keyed by where its payload starts in memory. Every store
+ * file is its own mapping, or a window into the archive mapping in archive
+ * order, so sorting by key orders work by file and offset.
+ */
+typedef struct {
+    uintptr_t key;
+    size_t index;
+} job_T;
+
+int
+compare_jobs(const void *a, const void *b)
+{
+    const uintptr_t left = ((const job_T*)a)->key;
+    const uintptr_t right = ((const job_T*)b)->key;
+
+    return (left > right) - (left < right);
+}
+
+/*
+ * Resolves the given entries in store order rather than in index order,
+ * which is sorted by hash: the XALZ headers are then read front to back and
+ * the kernel readahead keeps up. Without memory for the sort they are
+ * resolved in the given order.
+ */
+void
+store_resolve_sorted(dabu_T *store, const size_t *indices, const size_t count)
+{
+    job_T *jobs = malloc(count * sizeof(job_T));
+    if (!jobs)
+    {
+        for (size_t i = 0; i < count; i++)
+            store_resolve(store, indices[i]);
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        jobs[i].key = (uintptr_t)store_map(store, indices[i])->data + store->entries[indices[i]].data_offset;
+        jobs[i].index = indices[i];
+    }
+
+    qsort(jobs, count, sizeof(job_T), compare_jobs);
+
+    for (size_t i = 0; i < count; i++)
+        store_resolve(store, jobs[i].index);
+
+    free(jobs);
+}
+
+/*
+ * Offset of the decoded assembly of an entry slot in the cache file, 0 when
+ * it is not cached.
+ */
+uint64_t
+store_cached(const dabu_T *store, const size_t index)
+{
+    return store->cached ? store->cached[index].payload_offset : 0;
+}
+
+/*
+ * Whether the cache file the store was opened with holds every entry slot
+ * resolved. There is nothing to add to such a file but assemblies.
+ */
+bool
+cache_complete(const dabu_T *store)
+{
+    if (!store->cached)
+        return false;
+
+    for (size_t i = 0; i < store->count; i++)
+    {
+        if (store->cached[i].state == ENTRY_UNRESOLVED)
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Whether entry slots were resolved since the store was opened that its
+ * cache file, if any, does not hold yet.
+ */
+bool
+cache_stale(const dabu_T *store)
+{
+    for (size_t i = 0; i < store->count; i++)
+    {
+        if (store->state[i] != ENTRY_UNRESOLVED && (!store->cached || store->cached[i].state == ENTRY_UNRESOLVED))
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ * Writes the cache file of a store set from the entry slots resolved so far,
+ * the others are recorded unresolved and resolved when read. payloads, when given,
+ * holds the decoded assembly of each entry slot or NULL; assemblies of the
+ * cache file the store was opened with are carried over. The file is
+ * written under a temporary name and renamed into place, so concurrent
+ * writers of the same blob leave one complete file.
+ */
+int
+cache_write(dabu_T *store, const uint8_t **payloads)
+{
+    const size_t count = store->count;
+    cache_entry_T *records = calloc(count, sizeof(cache_entry_T));
+    const uint8_t **sources = calloc(count, sizeof(const uint8_t*));
+    char *path = cache_path(store->cache_dir, store->fingerprint);
+    char *tmp = cache_path(store->cache_dir, store->fingerprint);
+    int ret = -1;
+
+    if (!records || !sources || !path || !tmp)
+    {
+        fprintf(stderr, "malloc() failed file:%s:%d\n", __FILE__, __LINE__);
+        goto EXIT;
+    }
+
+    if (make_dir(store->block, NULL, store->cache_dir) < 0)
+        goto EXIT;
+
+    // Every slot of an index entry shares its name.
+    uint64_t strings_size = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const assembly_entry_T *entry = &store->entries[i];
+        cache_entry_T *record = &records[i];
+
+        record->index = entry->index;
+        record->hash32 = entry->hash32;
+        record->size = entry->size;
+        record->file = store->file_of[i];
+        record->state = store->state[i];
+        record->compressed = entry->compressed;
+        record->name_len = entry->name_len;
+
+        if (i > 0 && entry->name == store->entries[i - 1].name)
+            record->name_offset = records[i - 1].name_offset;
+        else
+        {
+            record->name_offset = (uint32_t)strings_size;
+            strings_size += entry->name_len + 1;
+        }
+    }
+
+    uint64_t offset = sizeof(cache_header_T) + (count * sizeof(cache_entry_T)) + strings_size;
+    for (size_t i = 0; i < count; i++)
+    {
+        cache_entry_T *record = &records[i];
+
+        sources[i] = payloads ? payloads[i] : NULL;
+        if (!sources[i] && store_cached(store, i))
+            sources[i] = map_range(&store->cache, store_cached(store, i), record->size);
+
+        if (!sources[i] || record->state != ENTRY_VALID || !record->size)
+            continue;
+
+        offset = (offset + (CACHE_ALIGN - 1)) & ~((uint64_t)CACHE_ALIGN - 1);
+        record->payload_offset = offset;
+        offset += record->size;
+    }
+
+#ifdef _WIN32
+    snprintf(tmp + strlen(tmp), 64, ".%d.%p.tmp", _getpid(), (const void*)store);
+#else
+    snprintf(tmp + strlen(tmp), 64, ".%d.%p.tmp", (int)getpid(), (const void*)store);
+#endif
+
+    FILE *file = fopen(tmp, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "fopen() failed for %s: %s\n", tmp, strerror(errno));
+        goto EXIT;
+    }
+
+    cache_header_T header = { 0 };
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.fingerprint = store->fingerprint;
+    header.blob_size = store->blob_size;
+    header.entry_count = (uint32_t)count;
+    header.strings_size = strings_size;
+
+    bool ok = fwrite(&header, sizeof(cache_header_T), 1, file) == 1
+        && fwrite(records, sizeof(cache_entry_T), count, file) == count;
+
+    uint64_t names = 0;
+    for (size_t i = 0; ok && i < count; i++)
+    {
+        if (records[i].name_offset != names) continue;
+
+        ok = fwrite(store->entries[i].name, records[i].name_len + 1, 1, file) == 1;
+        names += records[i].name_len + 1;
+    }
+
+    uint64_t position = sizeof(cache_header_T) + (count * sizeof(cache_entry_T)) + strings_size;
+    const char pad[CACHE_ALIGN] = { 0 };
+    for (size_t i = 0; ok && i < count; i++)
+    {
+        if (!records[i].payload_offset) continue;
+
+        const size_t gap = (size_t)(records[i].payload_offset - position);
+        ok = (!gap || fwrite(pad, gap, 1, file) == 1) && fwrite(sources[i], records[i].size, 1, file) == 1;
+        position = records[i].payload_offset + records[i].size;
+    }
+
+    if (fclose(file) != 0)
+        ok = false;
+
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows.
+    if (ok)
+        remove(path);
+#endif
+
+    if (ok && rename(tmp, path) == 0)
+        ret = 0;
+    else
+    {
+        fprintf(stderr, "failed writing decode cache %s\n", path);
+        remove(tmp);
+    }
+
+EXIT:
+    free(records);
+    free(sources);
+    free(path);
+    free(tmp);
+
+    return ret;
+}
+
+/*
+ * Decompresses a resolved entry into out, which holds at least entry->size
+ * bytes. The compressed payload is decoded straight out of the mapping,
+ * a stored one is copied.
+ */
+bool
+decode_payload(const mapping_T *map, const assembly_entry_T *entry, char *out)
+{
+    const char *compressed_payload = map_range(map, entry->data_offset, entry->data_size);
+    if (!compressed_payload)
+        return false;
+
+    if (!entry->compressed)
+    {
+        memcpy(out, compressed_payload, entry->size);
+        return true;
+    }
+
+    compressed_payload += sizeof(xalz_T);
+
+    // Both sides are bounded: the input by the descriptor, the output by the
+    // size announced in the XALZ header.
+    const int compressed_size = (int)(entry->data_size - sizeof(xalz_T));
+    int ret = LZ4_decompress_safe(compressed_payload, out, compressed_size, (int)entry->size);
+    if (ret < 0 || (uint32_t)ret != entry->size)
+    {
+        fprintf(stderr, "LZ4 decompression failed for %s\n", entry->name);
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Decoded size of a debug or config payload: the XALZ size when the payload
+ * is wrapped, the stored size otherwise. 0 when there is none or when it
+ * lies outside the mapping.
+ */
+uint32_t
+extra_size(const mapping_T *map, const uint32_t offset, const uint32_t stored)
+{
+    const uint8_t *payload = map_range(map, offset, stored);
+    if (!stored || !payload) return 0;
+
+    if (stored <= sizeof(xalz_T)) return stored;
+
+    xalz_T xalz = { 0 };
+    memcpy(&xalz, payload, sizeof(xalz_T));
+
+    if (xalz.magic != XALZ_MAGIC) return stored;
+
+    return xalz_size_valid(&xalz, stored) ? xalz.size : 0;
+}
+
+/*
+ * Decodes a debug or config payload into out, which holds the size returned
+ * by extra_size().
+ */
+bool
+extra_decode(const mapping_T *map, const uint32_t offset, const uint32_t stored, char *out, const uint32_t size)
+{
+    const char *payload = map_range(map, offset, stored);
+    if (!payload) return false;
+
+    if (stored <= sizeof(xalz_T) || ((const xalz_T*)payload)->magic != XALZ_MAGIC)
+    {
+        if (size != stored) return false;
+
+        memcpy(out, payload, size);
+        return true;
+    }
+
+    const int ret = LZ4_decompress_safe(payload + sizeof(xalz_T), out, (int)(stored - sizeof(xalz_T)), (int)size);
+
+    return ret >= 0 && (uint32_t)ret == size;
+}
+
+void
+stats_add(dump_stats_T *stats, const dump_stats_T *other)
+{
+    stats->table_seconds += other->table_seconds;
+    stats->manifest_seconds += other->manifest_seconds;
+    stats->io_seconds += other->io_seconds;
+    stats->decode_seconds += other->decode_seconds;
+    stats->write_seconds += other->write_seconds;
+    stats->total_seconds += other->total_seconds;
+    stats->bytes_in += other->bytes_in;
+    stats->bytes_out += other->bytes_out;
+    stats->bytes_written += other->bytes_written;
+    stats->entries += other->entries;
+    stats->listed += other->listed;
+    stats->decoded += other->decoded;
+    stats->failed += other->failed;
+    stats->skipped += other->skipped;
+    stats->deduplicated += other->deduplicated;
+    stats->cached += other->cached;
+
+    if (other->arena_peak > stats->arena_peak)
+        stats->arena_peak = other->arena_peak;
+}
+
+/*
+ * Reads one byte per page of a stored payload.
+ */
+void
+payload_touch(const mapping_T *map, const uint32_t offset, const uint32_t size)
+{
+    const volatile uint8_t *data = map_range(map, offset, size);
+    if (!data) return;
+
+    uint8_t sum = 0;
+    for (size_t i = 0; i < size; i += 4096)
+        sum += data[i];
+
+    (void)sum;
+}
+
+/*
+ * Shell style match of the whole name: '*' matches any run of characters,
+ * '?' a single one and '[...]' a set, with ranges and '!' or '^' negation.
+ */
+bool
+glob_match(const char *pattern, const char *text)
+{
+    const char *star = NULL;
+    const char *resume = NULL;
+
+    while (*text)
+    {
+        if (*pattern == '*')
+        {
+            star = pattern++;
+            resume = text;
+            continue;
+        }
+
+        bool matched = false;
+        const char *next = pattern + 1;
+
+        if (*pattern == '?')
+            matched = true;
+        else if (*pattern == '[')
+        {
+            const char *iter = pattern + 1;
+            const bool negate = (*iter == '!' || *iter == '^');
+            if (negate) iter++;
+
+            bool in_set = false;
+            const char *set = iter;
+            while (*iter && (*iter != ']' || iter == set))
+            {
+                if (iter[1] == '-' && iter[2] && iter[2] != ']')
+                {
+                    if ((unsigned char)*text >= (unsigned char)iter[0] && (unsigned char)*text <= (unsigned char)iter[2])
+                        in_set = true;
+                    iter += 3;
+                }
+                else
+                {
+                    if (*iter == *text)
+                        in_set = true;
+                    iter++;
+                }
+            }
+
+            // An unterminated set is taken literally.
+            if (*iter == ']')
+            {
+                matched = (in_set != negate);
+                next = iter + 1;
+            }
+            else
+                matched = (*text == '[');
+        }
+        else if (*pattern)
+            matched = (*pattern == *text);
+
+        if (matched)
+        {
+            pattern = next;
+            text++;
+        }
+        else if (star)
+        {
+            pattern = star + 1;
+            text = ++resume;
+        }
+        else
+            return false;
+    }
+
+    while (*pattern == '*')
+        pattern++;
+
+    return *pattern == '\0';
+}
+
+#define FILTER_REGEX_PREFIX "re:"
+
+typedef struct {
+    const char *glob;
+#ifndef _WIN32
+    regex_t regex;
+#endif
+} pattern_T;
+
+/*
+ * Compiled include and exclude lists of dump_options_T. Names are filtered
+ * before their XALZ header is read, so dropped entries cost no payload I/O.
+ */
+typedef struct {
+    pattern_T *include;
+    size_t include_count;
+    pattern_T *exclude;
+    size_t exclude_count;
+} filter_T;
+
+int
+patterns_compile(const char *const *list, pattern_T **patterns, size_t *count)
+{
+    *patterns = NULL;
+    *count = 0;
+
+    if (!list) return 0;
+
+    size_t n = 0;
+    while (list[n]) n++;
+    if (!n) return 0;
+
+    *patterns = calloc(n, sizeof(pattern_T));
+    if (!*patterns)
+    {
+        fprintf(stderr, "calloc() failed file:%s:%d\n", __FILE__, __LINE__);
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        pattern_T *pattern = &(*patterns)[i];
+
+        if (strncmp(list[i], FILTER_REGEX_PREFIX, strlen(FILTER_REGEX_PREFIX)) != 0)
+        {
+            pattern->glob = list[i];
+            (*count)++;
+            continue;
+        }
+
+#ifdef _WIN32
+        fprintf(stderr, "regular expression filters are not supported on this platform: %s\n", list[i]);
+        return -1;
+#else
+        const char *expr = list[i] + strlen(FILTER_REGEX_PREFIX);
+        if (regcomp(&pattern->regex, expr, REG_EXTENDED | REG_NOSUB) != 0)
+        {
+            fprintf(stderr, "invalid regular expression filter: %s\n", expr);
+            return -1;
+        }
+        (*count)++;
+#endif
+    }
+
+    return 0;
+}
+
+void
+patterns_free(pattern_T *patterns, const size_t count)
+{
+#ifndef _WIN32
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!patterns[i].glob)
+            regfree(&patterns[i].regex);
+    }
+#else
+    (void)count;
+#endif
+
+    free(patterns);
+}
+
+bool
+patterns_match(const pattern_T *patterns, const size_t count, const char *name)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (patterns[i].glob)
+        {
+            if (glob_match(patterns[i].glob, name))
+                return true;
+        }
+#ifndef _WIN32
+        else if (regexec(&patterns[i].regex, name, 0, NULL, 0) == 0)
+            return true;
+#endif
+    }
+
+    return false;
+}
+
+void
+filter_free(filter_T *filter)
+{
+    patterns_free(filter->include, filter->include_count);
+    patterns_free(filter->exclude, filter->exclude_count);
+    memset(filter, 0, sizeof(filter_T));
+}
+
+int
+filter_init(filter_T *filter, const dump_options_T *options)
+{
+    memset(filter, 0, sizeof(filter_T));
+
+    if (patterns_compile(options->include, &filter->include, &filter->include_count) < 0
+            || patterns_compile(options->exclude, &filter->exclude, &filter->exclude_count) < 0)
+    {
+        filter_free(filter);
+        return -1;
+    }
+
+    return 0;
+}
+
+bool
+filter_active(const filter_T *filter)
+{
+    return filter->include_count || filter->exclude_count;
+}
+
+/*
+ * An entry is kept when it matches one of the include patterns, or there are
+ * none, and none of the exclude patterns.
+ */
+bool
+filter_pass(const filter_T *filter, const char *name)
+{
+    if (filter->include_count && !patterns_match(filter->include, filter->include_count, name))
+        return false;
+
+    return !patterns_match(filter->exclude, filter->exclude_count, name);
+}
+
+#define TAR_BLOCK 512
+#define TAR_NAME_SIZE 100
+#define ARCHIVE_BUFFER_SIZE (64 * 1024)
+
+/*
+ * ustar archive written to a file or stdout. Headers go through the stdio
+ * buffer, payloads are written straight from the arena.
+ */
+typedef struct {
+    FILE *file;
+    bool owned;
+    bool failed;
+    uint64_t mtime;
+    char *buffer;
+} archive_T;
+
+typedef struct {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char chksum[8];
+    char typeflag;
+    char linkname[100];
+    char magic[6];
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char pad[12];
+} tar_header_T;
+
+void
+tar_octal(char *field, const size_t width, const uint64_t value)
+{
+    snprintf(field, width, "%0*llo", (int)(width - 1), (unsigned long long)value);
+}
+
+bool
+archive_write(archive_T *archive, const void *data, const size_t size)
+{
+    if (archive->failed) return false;
+
+    if (size && fwrite(data, 1, size, archive->file) != size)
+    {
+        fprintf(stderr, "failed writing archive: %s\n", strerror(errno));
+        archive->failed = true;
+    }
+
+    return !archive->failed;
+}
+
+bool
+archive_pad(archive_T *archive, const uint64_t size)
+{
+    static const char zeros[TAR_BLOCK] = { 0 };
+    const size_t pad = (size_t)((TAR_BLOCK - (size % TAR_BLOCK)) % TAR_BLOCK);
+
+    return archive_write(archive, zeros, pad);
+}
+
+bool
+tar_header(archive_T *archive, const char *name, const uint64_t size, const char type)
+{
+    tar_header_T header;
+    memset(&header, 0, sizeof(header));
+
+    // The field needs no terminator, longer names went to a pax header.
+    const size_t len = strlen(name);
+    memcpy(header.name, name, (len < sizeof(header.name)) ? len : sizeof(header.name));
+    tar_octal(header.mode, sizeof(header.mode), 0644);
+    tar_octal(header.uid, sizeof(header.uid), 0);
+    tar_octal(header.gid, sizeof(header.gid), 0);
+    tar_octal(header.size, sizeof(header.size), size);
+    tar_octal(header.mtime, sizeof(header.mtime), archive->mtime);
+    header.typeflag = type;
+    memcpy(header.magic, "ustar", 6);
+    memcpy(header.version, "00", 2);
+
+    // The checksum is computed with its own field filled with spaces.
+    memset(header.chksum, ' ', sizeof(header.chksum));
+    unsigned int sum = 0;
+    for (size_t i = 0; i < sizeof(header); i++)
+        sum += ((const unsigned char*)&header)[i];
+    snprintf(header.chksum, sizeof(header.chksum), "%06o", sum);
+    header.chksum[7] = ' ';
+
+    return archive_write(archive, &header, sizeof(header));
+}
+
+/*
+ * Names that do not fit the 100 byte ustar field get a pax extended header
+ * carrying the full path.
+ */
+bool
+tar_long_name(archive_T *archive, const char *name, const size_t len)
+{
+    // "<length> path=<name>\n", where length counts its own digits.
+    const size_t body = sizeof(" path=") - 1 + len + 1;
+    size_t total = body + 1;
+    while (total != body + (size_t)snprintf(NULL, 0, "%zu", total))
+        total = body + (size_t)snprintf(NULL, 0, "%zu", total);
+
+    char *record = malloc(total + 1);
+    if (!record)
+    {
+        archive->failed = true;
+        return false;
+    }
+
+    snprintf(record, total + 1, "%zu path=%s\n", total, name);
+
+    const bool ok = tar_header(archive, "././@PaxHeader", total, 'x')
+        && archive_write(archive, record, total)
+        && archive_pad(archive, total);
+
+    free(record);
+
+    return ok;
+}
+
+bool
+archive_add(archive_T *archive, const char *name, const uint8_t *data, const size_t size)
+{
+    const size_t len = strlen(name);
+
+    if (len >= TAR_NAME_SIZE && !tar_long_name(archive, name, len))
+        return false;
+
+    return tar_header(archive, name, size, '0')
+        && archive_write(archive, data, size)
+        && archive_pad(archive, size);
+}
+
+/*
+ * Opens path for writing, "-" writes the archive to stdout.
+ */
+int
+archive_open(archive_T *archive, const char *path)
+{
+    memset(archive, 0, sizeof(archive_T));
+
+    if (strcmp(path, "-") == 0)
+    {
+        archive->file = stdout;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+    else
+    {
+        archive->file = fopen(path, "wb");
+        archive->owned = true;
+    }
+
+    if (!archive->file)
+    {
+        fprintf(stderr, "failed opening archive %s\n", path);
+        return -1;
+    }
+
+    archive->buffer = malloc(ARCHIVE_BUFFER_SIZE);
+    if (archive->buffer)
+        setvbuf(archive->file, archive->buffer, _IOFBF, ARCHIVE_BUFFER_SIZE);
+
+    archive->mtime = (uint64_t)time(NULL);
+
+    return 0;
+}
+
+/*
+ * Writes the end of archive marker and closes the file. Returns -1 when any
+ * write failed.
+ */
+int
+archive_close(archive_T *archive)
+{
+    static const char zeros[TAR_BLOCK * 2] = { 0 };
+
+    if (!archive->file) return -1;
+
+    archive_write(archive, zeros, sizeof(zeros));
+
+    if (fflush(archive->file) != 0)
+        archive->failed = true;
+
+    if (archive->owned)
+        fclose(archive->file);
+    else
+        setvbuf(archive->file, NULL, _IOFBF, BUFSIZ);
+
+    free(archive->buffer);
+
+    const int ret = archive->failed ? -1 : 0;
+    memset(archive, 0, sizeof(archive_T));
+
+    return ret;
+}
+
+/*
+ * Payloads of a descriptor: the assembly, its debug symbols and its config.
+ */
+#define PAYLOAD_DATA 0
+#define PAYLOAD_DEBUG 1
+#define PAYLOAD_CONFIG 2
+#define PAYLOAD_KINDS 3
+
+/*
+ * Returns the decoded payload of the given kind and where it is stored,
+ * NULL when the entry has none or it was not asked for.
+ */
+const uint8_t*
+entry_payload(const assembly_entry_T *entry, const int kind, uint32_t *offset, uint32_t *stored, uint32_t *size)
+{
+    switch (kind)
+    {
+        case PAYLOAD_DEBUG:
+            *offset = entry->debug_data_offset;
+            *stored = entry->debug_data_size;
+            *size = entry->debug_size;
+            return entry->debug;
+        case PAYLOAD_CONFIG:
+            *offset = entry->config_data_offset;
+            *stored = entry->config_data_size;
+            *size = entry->config_size;
+            return entry->config;
+        default:
+            *offset = entry->data_offset;
+            *stored = entry->data_size;
+            *size = entry->size;
+            return entry->data;
+    }
+}
+
+/*
+ * Orders the payloads an entry has to decode by their offset in the store,
+ * which is how they are laid out, so one entry is a single forward sweep.
+ * Returns how many kinds were written to kinds.
+ */
+size_t
+entry_sweep(const assembly_entry_T *entry, int *kinds)
+{
+    uint32_t offsets[PAYLOAD_KINDS];
+    size_t count = 0;
+
+    for (int kind = 0; kind < PAYLOAD_KINDS; kind++)
+    {
+        uint32_t offset = 0, stored = 0, size = 0;
+        if (!entry_payload(entry, kind, &offset, &stored, &size) && kind != PAYLOAD_DATA)
+            continue;
+
+        size_t i = count++;
+        for (; i > 0 && offsets[i - 1] > offset; i--)
+        {
+            offsets[i] = offsets[i - 1];
+            kinds[i] = kinds[i - 1];
+        }
+
+        offsets[i] = offset;
+        kinds[i] = kind;
+    }
+
+    return count;
+}
+
+/*
+ * Neighbouring payloads closer than this are prefetched as one range.
+ */
+#define ADVISE_GAP (64 * 1024)
+
+/*
+ * Returns the table indices sorted by payload position, so the pool sweeps
+ * every file forward, or NULL when it cannot be allocated. Each run of
+ * neighbouring payloads is announced to the kernel as one sequential range
+ * to prefetch. Assemblies read back from the decode cache are placed and
+ * prefetched by their position in the cache file.
+ */
+size_t*
+decode_order(block_T *block, const assembly_table_T *table, const mapping_T **maps, const mapping_T *cache, const uint64_t *cached)
+{
+    const size_t count = table->count;
+    size_t *order = block_alloc(block, count * sizeof(size_t));
+    job_T *jobs = malloc(count * sizeof(job_T));
+
+    if (!order || !jobs)
+    {
+        free(jobs);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (cached && cached[i])
+            jobs[i].key = (uintptr_t)cache->data + cached[i];
+        else
+            jobs[i].key = (uintptr_t)maps[i]->data + table->entries[i].data_offset;
+        jobs[i].index = i;
+    }
+
+    qsort(jobs, count, sizeof(job_T), compare_jobs);
+
+    const mapping_T *run_map = NULL;
+    uint64_t run_begin = 0;
+    uint64_t run_end = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t index = jobs[i].index;
+        const assembly_entry_T *entry = &table->entries[index];
+        order[i] = index;
+
+        // The debug and config payloads are part of the entry's span, a
+        // cached assembly is its own span in the cache file.
+        int kinds[PAYLOAD_KINDS];
+        const bool from_cache = cached && cached[index];
+        const mapping_T *map = from_cache ? cache : maps[index];
+        const size_t sweep = from_cache ? 0 : entry_sweep(entry, kinds);
+        uint64_t begin = from_cache ? cached[index] : UINT64_MAX;
+        uint64_t end = from_cache ? cached[index] + entry->size : 0;
+
+        for (size_t k = 0; k < sweep; k++)
+        {
+            uint32_t offset = 0, stored = 0, size = 0;
+            entry_payload(entry, kinds[k], &offset, &stored, &size);
+
+            if (offset < begin) begin = offset;
+            if ((uint64_t)offset + stored > end) end = (uint64_t)offset + stored;
+        }
+
+        if (run_map == map && begin <= run_end + ADVISE_GAP)
+        {
+            if (begin < run_begin) run_begin = begin;
+            if (end > run_end) run_end = end;
+            continue;
+        }
+
+        if (run_map)
+            map_advise(run_map, run_begin, run_end - run_begin, ADVISE_SEQUENTIAL | ADVISE_WILLNEED);
+
+        run_map = map;
+        run_begin = begin;
+        run_end = end;
+    }
+
+    if (run_map)
+        map_advise(run_map, run_begin, run_end - run_begin, ADVISE_SEQUENTIAL | ADVISE_WILLNEED);
+
+    free(jobs);
+
+    return order;
+}
+
+typedef struct {
+    const mapping_T **maps;
+    // Table indices in the order they are decoded, NULL for index order.
+    const size_t *order;
+    // Stored assemblies are written from the mapping instead of the arena.
+    bool in_place;
+    // Offset of each table entry's assembly in the decode cache, 0 when it
+    // is decoded from the store. NULL without a cache hit.
+    const mapping_T *cache;
+    uint64_t *cached;
+    // Object path buffers per table entry with a content store.
+    char **objects;
+    assembly_table_T *table;
+    // PAYLOAD_KINDS slots per table entry, NULL for payloads not written.
+    const char **outputs;
+    const char **names;
+    bool *failed;
+    const dump_options_T *options;
+    bool *done;
+    size_t next;
+    mutex_T lock;
+    dump_stats_T *workers;
+    int write_flags;
+    struct write_queue_T *queue;
+    archive_T *archive;
+} decode_T;
+
+/*
+ * Hands finished entries to the archive and to the caller's callback in
+ * index order: the worker that completes the entry at the cursor also emits
+ * every finished entry behind it. Callbacks are serialized by the lock.
+ */
+void
+decode_emit(decode_T *decode, const size_t index, dump_stats_T *stats)
+{
+    if (!decode->options->on_entry && !decode->archive) return;
+
+    mutex_lock(&decode->lock);
+
+    decode->done[index] = true;
+    while (decode->next < decode->table->count && decode->done[decode->next])
+    {
+        const size_t i = decode->next++;
+        if (decode->failed[i]) continue;
+
+        const assembly_entry_T *entry = &decode->table->entries[i];
+
+        for (int kind = 0; decode->archive && kind < PAYLOAD_KINDS; kind++)
+        {
+            uint32_t offset = 0, stored = 0, size = 0;
+            const uint8_t *payload = entry_payload(entry, kind, &offset, &stored, &size);
+            const char *name = decode->names[(i * PAYLOAD_KINDS) + kind];
+            if (!payload || !name) continue;
+
+            const double start = stats ? now_seconds() : 0;
+
+            if (archive_add(decode->archive, name, payload, size) && stats)
+                stats->bytes_written += size;
+
+            if (stats)
+                stats->write_seconds += now_seconds() - start;
+        }
+
+        if (decode->options->on_entry)
+            decode->options->on_entry(entry, decode->options->ctx);
+    }
+
+    mutex_unlock(&decode->lock);
+}
+
+void
+decode_write(decode_T *decode, const size_t index, dump_stats_T *stats)
+{
+    const assembly_entry_T *entry = &decode->table->entries[index];
+    const double start = stats ? now_seconds() : 0;
+
+    for (int kind = 0; kind < PAYLOAD_KINDS; kind++)
+    {
+        uint32_t offset = 0, stored = 0, size = 0;
+        const uint8_t *payload = entry_payload(entry, kind, &offset, &stored, &size);
+        const char *output = decode->outputs ? decode->outputs[(index * PAYLOAD_KINDS) + kind] : NULL;
+
+        // The assembly goes to the content store once, outputs are copied,
+        // cloned or linked from it.
+        if (payload && kind == PAYLOAD_DATA && entry->object)
+        {
+            const char *object = decode->objects[index];
+            const int ret = cas_store(object, payload, size, decode->write_flags);
+
+            if (ret < 0)
+                fprintf(stderr, "cas_store() failed for %s\n", object);
+            else if (stats && ret == 0)
+                stats->deduplicated++;
+            else if (stats)
+                stats->bytes_written += size;
+
+            if (output && (ret < 0 || !cas_link(object, output, payload, size, decode->write_flags, decode->options->cas_hardlink)))
+                fprintf(stderr, "cas_link() failed for %s\n", output);
+
+            continue;
+        }
+
+        if (!payload || !output) continue;
+
+        const uint64_t cached = (kind == PAYLOAD_DATA && decode->cached) ? decode->cached[index] : 0;
+
+        size_t written = 0;
+        if (cached && decode->in_place)
+            written = write_output_copy(output, decode->cache, cached, size, decode->write_flags);
+        else if (kind == PAYLOAD_DATA && !entry->compressed && decode->in_place)
+            written = write_output_copy(output, decode->maps[index], offset, size, decode->write_flags);
+        else
+            written = write_output(output, (const char*)payload, size, decode->write_flags);
+
+        if (written <= 0)
+            fprintf(stderr, "write_output() failed for %s\n", output);
+        else if (stats)
+            stats->bytes_written += size;
+    }
+
+    if (stats)
+        stats->write_seconds += now_seconds() - start;
+}
+
+/*
+ * Output stage of an extraction: decode workers push the index of every
+ * decoded entry, writer threads pop them and create the files, so file
+ * creation latency no longer stalls decompression. Payloads stay in the
+ * arena until the dump returns, the queue only carries indexes and holds
+ * one slot per entry, it never fills up.
+ */
+typedef struct write_queue_T {
+#ifndef _WIN32
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+#endif
+    size_t *items;
+    size_t head;
+    size_t tail;
+    bool closed;
+} write_queue_T;
+
+typedef struct {
+    decode_T *decode;
+    dump_stats_T *stats;
+} writer_T;
+
+void
+queue_push(write_queue_T *queue, const size_t index)
+{
+#ifndef _WIN32
+    pthread_mutex_lock(&queue->lock);
+    queue->items[queue->tail++] = index;
+    pthread_cond_signal(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+#else
+    (void)queue;
+    (void)index;
+#endif
+}
+
+#ifndef _WIN32
+bool
+queue_pop(write_queue_T *queue, size_t *index)
+{
+    pthread_mutex_lock(&queue->lock);
+
+    while (queue->head == queue->tail && !queue->closed)
+        pthread_cond_wait(&queue->ready, &queue->lock);
+
+    const bool ok = (queue->head != queue->tail);
+    if (ok)
+        *index = queue->items[queue->head++];
+
+    pthread_mutex_unlock(&queue->lock);
+
+    return ok;
+}
+
+void
+queue_close(write_queue_T *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+void *
+writer_main(void *arg)
+{
+    writer_T *writer = arg;
+    size_t index = 0;
+
+    while (queue_pop(writer->decode->queue, &index))
+        decode_write(writer->decode, index, writer->stats);
+
+    return NULL;
+}
+
+/*
+ * Starts up to count writer threads draining decode->queue, writer i keeps
+ * its counters in stats[i] when stats is set. Returns the number of writers
+ * running; with none the decode workers write the files themselves.
+ */
+typedef struct {
+    write_queue_T queue;
+    pthread_t *threads;
+    writer_T *args;
+    size_t started;
+} writers_T;
+
 size_t
-assemblies_dump(
+writers_start(writers_T *writers, decode_T *decode, const size_t entries, const size_t count, dump_stats_T *stats)
+{
+    memset(writers, 0, sizeof(writers_T));
+
+    writers->queue.items = calloc(entries, sizeof(size_t));
+    writers->threads = calloc(count, sizeof(pthread_t));
+    writers->args = calloc(count, sizeof(writer_T));
+
+    if (!writers->queue.items || !writers->threads || !writers->args)
+    {
+        fprintf(stderr, "calloc() failed, writing from the decode workers\n");
+        goto FAIL;
+    }
+
+    pthread_mutex_init(&writers->queue.lock, NULL);
+    pthread_cond_init(&writers->queue.ready, NULL);
+    decode->queue = &writers->queue;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        writers->args[i].decode = decode;
+        writers->args[i].stats = stats ? &stats[i] : NULL;
+
+        if (pthread_create(&writers->threads[i], NULL, writer_main, &writers->args[i]) != 0)
+        {
+            fprintf(stderr, "pthread_create() failed file:%s:%d\n", __FILE__, __LINE__);
+            break;
+        }
+
+        writers->started++;
+    }
+
+    if (writers->started)
+        return writers->started;
+
+    decode->queue = NULL;
+    pthread_cond_destroy(&writers->queue.ready);
+    pthread_mutex_destroy(&writers->queue.lock);
+
+FAIL:
+    free(writers->queue.items);
+    free(writers->threads);
+    free(writers->args);
+    memset(writers, 0, sizeof(writers_T));
+
+    return 0;
+}
+
+/*
+ * Lets the writers drain the queue and waits for them.
+ */
+void
+writers_stop(writers_T *writers)
+{
+    if (!writers->started) return;
+
+    queue_close(&writers->queue);
+
+    for (size_t i = 0; i < writers->started; i++)
+        pthread_join(writers->threads[i], NULL);
+
+    pthread_cond_destroy(&writers->queue.ready);
+    pthread_mutex_destroy(&writers->queue.lock);
+
+    free(writers->queue.items);
+    free(writers->threads);
+    free(writers->args);
+    memset(writers, 0, sizeof(writers_T));
+}
+#endif
+
+/*
+ * Decompresses the table entry of one job into the arena slice reserved for
+ * it and writes it out when an output path was planned.
+ */
+void
+decode_entry(void *ctx, const size_t job, const size_t worker)
+{
+    decode_T *decode = ctx;
+    const size_t index = decode->order ? decode->order[job] : job;
+    assembly_entry_T *entry = &decode->table->entries[index];
+    const mapping_T *map = decode->maps[index];
+    dump_stats_T *stats = decode->workers ? &decode->workers[worker] : NULL;
+    const uint64_t cached = decode->cached ? decode->cached[index] : 0;
+    double start = 0;
+
+    // The assembly and the debug and config payloads asked for are read in
+    // store order, one forward sweep per entry.
+    int kinds[PAYLOAD_KINDS];
+    const size_t sweep = entry_sweep(entry, kinds);
+
+    for (size_t k = 0; stats && k < sweep; k++)
+    {
+        // Fault the compressed pages in up front so that mapping I/O and LZ4
+        // time are reported apart.
+        uint32_t offset = 0, stored = 0, size = 0;
+        entry_payload(entry, kinds[k], &offset, &stored, &size);
+        if (kinds[k] == PAYLOAD_DATA && cached) continue;
+
+        start = now_seconds();
+        payload_touch(map, offset, stored);
+        stats->io_seconds += now_seconds() - start;
+        stats->bytes_in += stored;
+    }
+
+    if (stats)
+        start = now_seconds();
+
+    for (size_t k = 0; k < sweep; k++)
+    {
+        uint32_t offset = 0, stored = 0, size = 0;
+        char *out = (char*)entry_payload(entry, kinds[k], &offset, &stored, &size);
+
+        if (kinds[k] == PAYLOAD_DATA && cached)
+        {
+            // Written from the cache file in place, or copied out of it.
+            if (!decode->in_place)
+                memcpy(out, map_range(decode->cache, cached, size), size);
+            if (stats) stats->cached++;
+            continue;
+        }
+
+        if (kinds[k] == PAYLOAD_DATA)
+        {
+            if ((!entry->compressed && decode->in_place) || decode_payload(map, entry, out))
+                continue;
+
+            decode->failed[index] = true;
+            if (stats) stats->failed++;
+            decode_emit(decode, index, stats);
+            return;
+        }
+
+        if (extra_decode(map, offset, stored, out, size))
+            continue;
+
+        // A broken debug or config payload does not cost the assembly.
+        fprintf(stderr, "Failed decoding the %s payload of %s\n", (kinds[k] == PAYLOAD_DEBUG) ? "debug" : "config", entry->name);
+
+        if (kinds[k] == PAYLOAD_DEBUG)
+            entry->debug = NULL;
+        else
+            entry->config = NULL;
+    }
+
+    if (stats)
+    {
+        stats->decode_seconds += now_seconds() - start;
+        // Assemblies read back from the cache were counted as cached.
+        if (!cached) stats->decoded++;
+        stats->bytes_out += entry->size;
+        if (entry->debug) stats->bytes_out += entry->debug_size;
+        if (entry->config) stats->bytes_out += entry->config_size;
+        start = now_seconds();
+    }
+
+    if (decode->options->cas)
+        entry->object = cas_object(decode->objects[index], decode->options->cas, entry->data, entry->size, decode->options->cas_sha256);
+
+    if ((decode->outputs && decode->outputs[index * PAYLOAD_KINDS]) || entry->object)
+    {
+        if (decode->queue)
+            queue_push(decode->queue, index);
+        else
+            decode_write(decode, index, stats);
+    }
+
+    decode_emit(decode, index, stats);
+}
+
+/*
+ * Writes the decode cache of a dump when the blob was not fully cached yet,
+ * or when cache_data is set and assemblies were decoded that the cache file
+ * does not hold. The entries the dump filtered out are resolved as well, so
+ * the table is complete. failed is NULL when no payload was decoded.
+ */
+void
+dump_cache(dabu_T *store, const assembly_table_T *table, const size_t *slots, const bool *failed, const dump_options_T *options)
+{
+    bool stale = !cache_complete(store);
+    const uint8_t **payloads = NULL;
+
+    if (options->cache_data && failed)
+    {
+        payloads = calloc(store->count, sizeof(const uint8_t*));
+        if (!payloads)
+        {
+            fprintf(stderr, "calloc() failed file:%s:%d\n", __FILE__, __LINE__);
+            return;
+        }
+
+        for (size_t i = 0; i < table->count; i++)
+        {
+            if (failed[i] || !table->entries[i].data) continue;
+
+            payloads[slots[i]] = table->entries[i].data;
+            stale |= !store_cached(store, slots[i]);
+        }
+    }
+
+    size_t *indices = stale ? calloc(store->count, sizeof(size_t)) : NULL;
+    if (indices)
+    {
+        for (size_t i = 0; i < store->count; i++)
+            indices[i] = i;
+
+        store_resolve_sorted(store, indices, store->count);
+    }
+
+    if (stale)
+        cache_write(store, payloads);
+
+    free(indices);
+    free(payloads);
+}
+
+size_t
+dump_blob(
 	block_T **block,
 	const char *path,
-	assembly_T **list,
-	const bool dump)
+	assembly_table_T *table,
+	const dump_options_T *options)
 {
-    if (path == NULL || *path == '\0' || strlen(path) <= 0)
+    const bool dump = options->dump;
+    const bool list_only = options->list_only && !dump && !options->archive && !options->cas && !options->cache_data;
+    dump_stats_T *stats = options->stats;
+    const double start = now_seconds();
+
+    table->entries = NULL;
+    table->count = 0;
+
+    if (stats)
+        memset(stats, 0, sizeof(dump_stats_T));
+
+    filter_T filter = { 0 };
+    if (filter_init(&filter, options) < 0)
+        return 0;
+
+    // With a filter the arena cannot be planned before names are known, the
+    // payloads of the kept entries are reserved once they are filtered.
+    const bool filtered = filter_active(&filter);
+
+    dabu_T *store = store_open(block, path, !list_only && !filtered, stats, options->cache);
+    if (!store)
     {
-	printf("received invalid parameter\n");
+        filter_free(&filter);
+        if (stats) stats->total_seconds = now_seconds() - start;
         return 0;
     }
 
-    FILE *file = NULL;
-    FILE *manifest = NULL;
-    bool has_manifest = true;
+    const size_t count = store->count;
+
+    table->entries = block_alloc(*block, count * sizeof(assembly_entry_T));
+
+    const char *dir = get_parent_dir(*block, path);
+
+    // Entries are planned serially, each one gets its own slice of the
+    // arena, and only the decompression runs on the worker pool.
+    decode_T decode = { 0 };
+    decode.table = table;
+    decode.options = options;
+    decode.in_place = dump || options->archive || options->cas;
+    decode.maps = block_alloc(*block, count * sizeof(const mapping_T*));
+    decode.names = block_alloc(*block, count * PAYLOAD_KINDS * sizeof(const char*));
+    decode.failed = block_alloc(*block, count * sizeof(bool));
+    decode.done = block_alloc(*block, count * sizeof(bool));
+    if (dump)
+        decode.outputs = block_alloc(*block, count * PAYLOAD_KINDS * sizeof(const char*));
+    if (options->cas)
+        decode.objects = block_alloc(*block, count * sizeof(char*));
+    if (store->cached && !list_only)
+    {
+        decode.cache = &store->cache;
+        decode.cached = block_alloc(*block, count * sizeof(uint64_t));
+    }
+
+    // Table entry to entry slot, for the decode cache.
+    size_t *slots = block_alloc(*block, count * sizeof(size_t));
+
+    if (!table->entries || !decode.maps || !decode.names || !decode.failed || !decode.done || !slots
+            || (dump && !decode.outputs) || (options->cas && !decode.objects) || (decode.cache && !decode.cached))
+    {
+        fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+        goto EXIT;
+    }
+
+    if (options->cas && make_dir(*block, NULL, options->cas) < 0)
+        goto EXIT;
+
+    memset(decode.failed, 0, count * sizeof(bool));
+    memset(decode.done, 0, count * sizeof(bool));
+    memset(decode.names, 0, count * PAYLOAD_KINDS * sizeof(const char*));
+    if (dump)
+        memset(decode.outputs, 0, count * PAYLOAD_KINDS * sizeof(const char*));
+
+    // The store plan only covers the assemblies, debug and config payloads
+    // are reserved here once their sizes are known.
+    const bool extras = !list_only && (options->debug_data || options->config_data);
+
+    double phase = now_seconds();
+    size_t payload_size = 0;
+
+    size_t *selected = block_alloc(*block, count * sizeof(size_t));
+    size_t selected_count = 0;
+    if (!selected)
+    {
+        fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+        goto EXIT;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // Names come from the manifest, no payload byte has been read yet.
+        if (filtered && !filter_pass(&filter, store->entries[i].name))
+        {
+            if (stats) stats->skipped++;
+            continue;
+        }
+
+        selected[selected_count++] = i;
+    }
+
+    store_resolve_sorted(store, selected, selected_count);
+
+    for (size_t k = 0; k < selected_count; k++)
+    {
+        const size_t i = selected[k];
+        const assembly_entry_T *resolved = store_resolve(store, i);
+        if (!resolved)
+        {
+            if (stats) stats->failed++;
+            continue;
+        }
+
+        assembly_entry_T *entry = &table->entries[table->count];
+        *entry = *resolved;
+        entry->data = NULL;
+        decode.maps[table->count] = store_map(store, i);
+        slots[table->count] = i;
+
+        const uint64_t cached = decode.cached ? store_cached(store, i) : 0;
+        if (decode.cached)
+            decode.cached[table->count] = cached;
+
+        if (list_only && options->on_entry)
+            options->on_entry(entry, options->ctx);
+
+        if (!decode.in_place || (resolved->compressed && !cached))
+            payload_size += resolved->size + BLOCK_ALIGN;
+        if (dump)
+            payload_size += sizeof(string_T) + strlen(path) + resolved->name_len + (BLOCK_ALIGN * 2);
+        if (options->cas)
+            payload_size += cas_path_size(options->cas) + BLOCK_ALIGN;
+
+        if (extras && options->debug_data)
+            entry->debug_size = extra_size(decode.maps[table->count], entry->debug_data_offset, entry->debug_data_size);
+
+        if (extras && options->config_data)
+            entry->config_size = extra_size(decode.maps[table->count], entry->config_data_offset, entry->config_data_size);
+
+        if (entry->debug_size || entry->config_size)
+        {
+            payload_size += entry->debug_size + entry->config_size + (BLOCK_ALIGN * 2);
+            payload_size += (sizeof(string_T) + strlen(path) + resolved->name_len + (BLOCK_ALIGN * 2)) * 4;
+        }
+
+        table->count++;
+    }
+
+    if (!list_only && (filtered || extras || options->cas) && block_reserve(*block, block_used(*block) + payload_size) < 0)
+    {
+        fprintf(stderr, "block_reserve() failed\n");
+        goto EXIT;
+    }
+
+    const char *made = NULL;
+    for (size_t i = 0; !list_only && i < table->count; i++)
+    {
+        assembly_entry_T *entry = &table->entries[i];
+
+        // Stored and cached assemblies that are only written out never enter
+        // the arena.
+        if (decode.cached && decode.cached[i] && decode.in_place)
+            entry->data = map_range(decode.cache, decode.cached[i], entry->size);
+        else if (!entry->compressed && decode.in_place)
+            entry->data = map_range(decode.maps[i], entry->data_offset, entry->size);
+        else
+            entry->data = block_alloc(*block, entry->size);
+
+        if (!entry->data)
+        {
+            fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+            goto EXIT;
+        }
+
+        if (entry->debug_size)
+            entry->debug = block_alloc(*block, entry->debug_size);
+
+        if (entry->config_size)
+            entry->config = block_alloc(*block, entry->config_size);
+
+        if (options->cas)
+            decode.objects[i] = block_alloc(*block, cas_path_size(options->cas));
+
+        if ((entry->debug_size && !entry->debug) || (entry->config_size && !entry->config)
+                || (options->cas && !decode.objects[i]))
+        {
+            fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+            goto EXIT;
+        }
+
+        const char **names = &decode.names[i * PAYLOAD_KINDS];
+
+        // Entries of a per-ABI store go below <abi>/, on disk and in the archive.
+        names[PAYLOAD_DATA] = entry->name;
+        if (entry->abi)
+        {
+            string_T *abi_dir = string_concat(*block, entry->abi, "/");
+            string_T *name = abi_dir ? string_concat(*block, abi_dir->buffer, entry->name) : NULL;
+
+            if (!name)
+            {
+                fprintf(stderr, "string operation failed\n");
+                goto EXIT;
+            }
+
+            names[PAYLOAD_DATA] = name->buffer;
+
+            if (dump && entry->abi != made && make_dir(*block, dir, entry->abi) < 0)
+                goto EXIT;
+
+            made = entry->abi;
+        }
+
+        if (entry->debug)
+            names[PAYLOAD_DEBUG] = change_file_ext(*block, names[PAYLOAD_DATA], ".pdb");
+
+        if (entry->config)
+        {
+            string_T *config = string_concat(*block, names[PAYLOAD_DATA], ".config");
+            names[PAYLOAD_CONFIG] = config ? config->buffer : NULL;
+        }
+
+        if ((entry->debug && !names[PAYLOAD_DEBUG]) || (entry->config && !names[PAYLOAD_CONFIG]))
+        {
+            fprintf(stderr, "string operation failed\n");
+            goto EXIT;
+        }
+
+        for (int kind = 0; dump && kind < PAYLOAD_KINDS; kind++)
+        {
+            if (!names[kind]) continue;
+
+            string_T *output = (dir) ? string_concat(*block, dir, names[kind]) : string_new(*block, names[kind]);
+
+            if (!output)
+            {
+                fprintf(stderr, "string operation failed\n");
+                goto EXIT;
+            }
+
+            decode.outputs[(i * PAYLOAD_KINDS) + kind] = output->buffer;
+        }
+    }
+
+    // Payloads are decoded in store order, each worker sweeping its share of
+    // a file forward, and still emitted by index through decode_emit().
+    if (!list_only)
+        decode.order = decode_order(*block, table, decode.maps, decode.cache, decode.cached);
 
-    file = fopen(path, "rb");
+    if (stats)
+        stats->io_seconds += now_seconds() - phase;
 
-    if (file == NULL)
+    if (list_only)
     {
-        fprintf(stderr, "Failed opening assemblies blob file\n");
-		return 0;
+        if (options->cache)
+            dump_cache(store, table, slots, NULL, options);
+
+        goto EXIT;
     }
 
-	size_t count = 0;
+    // Workers and writers keep their own counters, they are summed once the
+    // pool is done.
+    const size_t decoders = (options->jobs > 1) ? options->jobs : 1;
+    const size_t writer_count = (dump || options->cas) ? options->writers : 0;
+    const size_t workers = decoders + writer_count;
+    if (stats)
+    {
+        decode.workers = calloc(workers, sizeof(dump_stats_T));
+        if (!decode.workers)
+            fprintf(stderr, "calloc() failed, decode statistics disabled\n");
+    }
 
-    header_T header = { 0 };
+    if (options->preallocate) decode.write_flags |= WRITE_PREALLOCATE;
+    if (options->direct_io) decode.write_flags |= WRITE_DIRECT;
 
-    int r = read_header(file, &header);
+#ifndef _WIN32
+    writers_T writers;
+    if (writer_count && table->count)
+        writers_start(&writers, &decode, table->count, writer_count, decode.workers ? decode.workers + decoders : NULL);
+    else
+        memset(&writers, 0, sizeof(writers_T));
+#endif
 
-    if (r < 0)
+    // The archive is fed in index order as entries come out of the pool.
+    archive_T archive;
+    if (options->archive)
     {
-        fprintf(stderr, "Failed reading file\n");
-		goto EXIT;
-    }
+        if (archive_open(&archive, options->archive) < 0)
+        {
+#ifndef _WIN32
+            writers_stop(&writers);
+#endif
+            free(decode.workers);
+            table->count = 0;
+            goto EXIT;
+        }
 
-    if (header.magic != XABA_MAGIC)
-    {
-        fprintf(stderr, "%s is not a AssemblyStore File\n", path);
-		goto EXIT;
+        decode.archive = &archive;
     }
 
-    if (header.magic != XABA_MAGIC)
+    mutex_init(&decode.lock);
+    run_parallel(table->count, options->jobs, decode_entry, &decode);
+    mutex_destroy(&decode.lock);
+
+#ifndef _WIN32
+    writers_stop(&writers);
+#endif
+
+    if (decode.archive && archive_close(decode.archive) < 0)
+        fprintf(stderr, "failed writing archive %s\n", options->archive);
+
+    if (decode.workers)
     {
-        fprintf(stderr, "This is not a AssemblyStore File\n");
-		goto EXIT;
+        for (size_t i = 0; i < workers; i++)
+            stats_add(stats, &decode.workers[i]);
+
+        free(decode.workers);
     }
 
-    if(header.entry_count <= 0)
+    if (options->cache)
+        dump_cache(store, table, slots, decode.failed, options);
+
+    // Drop entries that failed to decompress, keeping index order. Stored
+    // and cached assemblies written in place have no data once the store is
+    // closed.
+    size_t kept = 0;
+    for (size_t i = 0; i < table->count; i++)
     {
-        fprintf(stderr, "received a non-valid entry count\n");
-		goto EXIT;
+        if (decode.failed[i]) continue;
+        const bool cached = decode.cached && decode.cached[i];
+        if (kept != i) table->entries[kept] = table->entries[i];
+        if (decode.in_place && (cached || !table->entries[kept].compressed)) table->entries[kept].data = NULL;
+        kept++;
     }
+    table->count = kept;
 
-    //TODO improve mem allocation calculation
-    *block = block_create((header.entry_count * (1024 * 1024)) + (sizeof(assembly_T) * header.entry_count));
+EXIT:
+    store_close(store);
+    filter_free(&filter);
 
-    if (!block)
+    if (stats)
     {
-        fprintf(stderr, "block_create() failed\n");
-		goto EXIT;
+        stats->listed = table->count;
+        stats->arena_peak = block_used(*block);
+        stats->total_seconds = now_seconds() - start;
     }
 
-    //assert(header.entry_count > 0);
+	return count;
+}
 
-    list_init(block, list, sizeof(assembly_T));
+size_t
+assemblies_dump(
+	block_T **block,
+	const char *path,
+	assembly_T **list,
+	const bool dump)
+{
+    assembly_table_T table = { 0 };
+    dump_options_T options = { 0 };
+    options.dump = dump;
+    // The list never exposes payloads, so without extraction there is
+    // nothing to decompress.
+    options.list_only = !dump;
 
-    const char *manifest_path = change_file_ext(*block, path, ".manifest");
+    size_t count = dump_blob(block, path, &table, &options);
 
-    manifest = fopen(manifest_path, "r");
-    if (manifest == NULL)
+    if (*block)
     {
-        fprintf(stderr, "Failed opening manifest file\n");
-	has_manifest = false;
+        list_init(block, list, sizeof(assembly_T));
+
+        assembly_T *tail = *list;
+        for (size_t i = 0; i < table.count; i++)
+        {
+            const assembly_entry_T *entry = &table.entries[i];
+
+            // Per-ABI entries are listed as <abi>/<name>, as they are extracted.
+            if (entry->abi)
+            {
+                char name[MAX_NAME];
+                snprintf(name, sizeof(name), "%s/%s", entry->abi, entry->name);
+                list_append(block, &tail, name, entry->size);
+            }
+            else
+                list_append(block, &tail, entry->name, entry->size);
+        }
     }
 
-    descriptor_T* descriptors = block_alloc(*block, header.entry_count * sizeof(descriptor_T));
-    if (!descriptors)
+    return count;
+}
+
+size_t
+assemblies_dump_table(
+	block_T **block,
+	const char *path,
+	assembly_table_T *table,
+	const bool dump)
+{
+    dump_options_T options = { 0 };
+    options.dump = dump;
+
+    return assemblies_dump_options(block, path, table, &options);
+}
+
+size_t
+assemblies_dump_options(
+	block_T **block,
+	const char *path,
+	assembly_table_T *table,
+	const dump_options_T *options)
+{
+    if (!table || !options) return 0;
+
+    dump_blob(block, path, table, options);
+
+    return table->count;
+}
+
+/*
+ * Binary search of an index table, which the runtime keeps sorted by hash.
+ * Returns the entry slot of the matching descriptor or DABU_NOT_FOUND. With
+ * several stores sharing a store id, the first one (the primary store, then
+ * the ABIs in name order) wins.
+ */
+size_t
+store_lookup(const dabu_T *store, const hash_T *list, const uint64_t hash, const bool wide)
+{
+    size_t lo = 0;
+    size_t hi = store->index_count;
+
+    while (lo < hi)
     {
-        fprintf(stderr, "block_alloc() failed: %s:%d\n", __FILE__, __LINE__);
-	goto EXIT;
+        const size_t mid = lo + ((hi - lo) / 2);
+        const uint64_t value = wide ? list[mid].hash64 : list[mid].hash32;
+
+        if (value < hash)
+            lo = mid + 1;
+        else if (value > hash)
+            hi = mid;
+        else
+        {
+            const uint32_t local = list[mid].local_store_index;
+
+            for (size_t f = 0; f < store->file_count; f++)
+            {
+                const store_file_T *file = &store->files[f];
+
+                if (file->header.store_id != list[mid].store_id)
+                    continue;
+
+                if (local >= file->header.entry_count || !file->by_descriptor[local])
+                    return DABU_NOT_FOUND;
+
+                return file->by_descriptor[local] - 1;
+            }
+
+            return DABU_NOT_FOUND;
+        }
     }
 
-    if (is_debug)
+    return DABU_NOT_FOUND;
+}
+
+size_t
+store_find(const dabu_T *store, const char *name, const size_t len)
+{
+    size_t index = store_lookup(store, store->hash64list, xxh64(name, len, 0), true);
+
+    if (index == DABU_NOT_FOUND)
+        index = store_lookup(store, store->hash32list, xxh32(name, len, 0), false);
+
+    return index;
+}
+
+/*
+ * Index names carry no ".dll" extension.
+ */
+size_t
+name_hash_len(const char *name)
+{
+    const size_t len = strlen(name);
+    const size_t ext = sizeof(".dll") - 1;
+
+    if (len > ext && strcmp(name + len - ext, ".dll") == 0)
+        return len - ext;
+
+    return len;
+}
+
+dabu_T*
+dabu_open(const char *path)
+{
+    return dabu_open_cached(path, NULL);
+}
+
+dabu_T*
+dabu_open_cached(const char *path, const char *cache)
+{
+    block_T *block = NULL;
+
+    dabu_T *store = store_open(&block, path, false, NULL, cache);
+    if (!store)
     {
-        fprintf(stdout, "magic: 0x%X, version: 0x%u, entries: %u, index_entries: %u, index_size: %u \n",
-                header.magic, header.version, header.entry_count, header.index_entry_count, header.index_size);
+        block_free(&block);
+        return NULL;
     }
 
-    for (size_t i = 0; i < header.entry_count; i++)
+    store->owns_block = true;
+
+    // The cache file is written when the handle is closed, the directory
+    // name has to outlive the caller's string.
+    if (cache)
     {
-        if (fread(
-                &descriptors[i],
-                sizeof(descriptor_T),
-                1,
-                file) != 1)
+        const size_t len = strlen(cache);
+        char *dir = block_alloc(block, len + 1);
+        if (!dir)
         {
-            fprintf(stderr, "fread() failed fie:%s:%d\n", __FILE__, __LINE__);
-            goto EXIT;
+            fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
+            dabu_close(&store);
+            return NULL;
         }
+
+        memcpy(dir, cache, len + 1);
+        store->cache_dir = dir;
     }
 
-    size_t fpos = ftell(file);
+    return store;
+}
 
-    count = header.index_entry_count;
-    if (count <= 0)
+size_t
+dabu_count(const dabu_T *store)
+{
+    return store ? store->count : 0;
+}
+
+const assembly_entry_T*
+dabu_entry(dabu_T *store, const size_t index)
+{
+    return store_resolve(store, index);
+}
+
+const char*
+dabu_name(const dabu_T *store, const size_t index)
+{
+    if (!store || index >= store->count) return NULL;
+
+    return store->entries[index].name;
+}
+
+size_t
+dabu_read(dabu_T *store, const size_t index, void *buffer, const size_t cap)
+{
+    if (!buffer) return 0;
+
+    const assembly_entry_T *entry = store_resolve(store, index);
+    if (!entry) return 0;
+
+    if (cap < entry->size)
     {
-        fprintf(stderr, "received a non-valid index entry count\n");
-		goto EXIT;
+        fprintf(stderr, "dabu_read() buffer too small for %s: 0x%zx < 0x%x\n", entry->name, cap, entry->size);
+        return 0;
     }
 
-    hash_T *hash32list =  block_alloc(*block, sizeof(hash_T) * count);
-    if(hash32list == NULL)
+    const uint64_t cached = store_cached(store, index);
+    if (cached)
+        memcpy(buffer, map_range(&store->cache, cached, entry->size), entry->size);
+    else if (!decode_payload(store_map(store, index), entry, buffer))
+        return 0;
+
+    return entry->size;
+}
+
+size_t
+dabu_find(dabu_T *store, const char *name)
+{
+    if (!store || !name || !*name) return DABU_NOT_FOUND;
+
+    const size_t len = name_hash_len(name);
+
+    size_t index = store_find(store, name, len);
+    if (index != DABU_NOT_FOUND)
+        return index;
+
+    // Extracted satellite assemblies are named culture_Name.resources.dll,
+    // the index knows them as culture/Name.resources.
+    const char *sep = memchr(name, '_', len);
+    if (!sep)
+        return DABU_NOT_FOUND;
+
+    char *alt = malloc(len);
+    if (!alt) return DABU_NOT_FOUND;
+
+    memcpy(alt, name, len);
+    for (size_t i = len; i-- > 0;)
     {
-	    fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
-            goto EXIT;
+        if (alt[i] != '_') continue;
+
+        alt[i] = '/';
+        index = store_find(store, alt, len);
+        if (index != DABU_NOT_FOUND) break;
+        alt[i] = '_';
     }
 
-    for (size_t i = 0; i < header.index_entry_count; i++)
+    free(alt);
+
+    return index;
+}
+
+uint32_t
+dabu_hash32(const char *name)
+{
+    return name ? xxh32(name, name_hash_len(name), 0) : 0;
+}
+
+uint64_t
+dabu_hash64(const char *name)
+{
+    return name ? xxh64(name, name_hash_len(name), 0) : 0;
+}
+
+void
+dabu_close(dabu_T **store)
+{
+    if (store && *store)
     {
-        if (fread(
-                &hash32list[i],
-                sizeof(hash_T),
-                1,
-                file) != 1)
-        {
-            fprintf(stderr, "fread() failed fie:%s:%d\n", __FILE__, __LINE__);
-            goto EXIT;
-        }
+        block_T *block = (*store)->owns_block ? (*store)->block : NULL;
+
+        if (block && (*store)->cache_dir && cache_stale(*store))
+            cache_write(*store, NULL);
+
+        store_close(*store);
+        block_free(&block);
+
+        *store = NULL;
     }
+}
 
-    hash_T *hash64list =  block_alloc(*block, sizeof(hash_T) * count);
-    if(hash64list == NULL)
+typedef struct {
+    char **items;
+    size_t count;
+    size_t cap;
+} path_list_T;
+
+int
+path_list_add(path_list_T *list, const char *path, const size_t len)
+{
+    if (list->count == list->cap)
     {
-	    fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
-            goto EXIT;
+        const size_t cap = list->cap ? list->cap * 2 : 64;
+        char **items = realloc(list->items, cap * sizeof(char*));
+        if (!items) return -1;
+
+        list->items = items;
+        list->cap = cap;
+    }
+
+    char *copy = malloc(len + 1);
+    if (!copy) return -1;
+
+    memcpy(copy, path, len);
+    copy[len] = '\0';
+    list->items[list->count++] = copy;
+
+    return 0;
+}
+
+void
+path_list_free(path_list_T *list)
+{
+    for (size_t i = 0; i < list->count; i++)
+        free(list->items[i]);
+
+    free(list->items);
+    memset(list, 0, sizeof(path_list_T));
+}
+
+bool
+has_blob_ext(const char *name)
+{
+    const size_t len = strlen(name);
+
+    if (len > 4 && (strcmp(name + len - 4, ".apk") == 0 || strcmp(name + len - 4, ".aab") == 0))
+        return true;
+
+    return len > 5 && strcmp(name + len - 5, ".blob") == 0;
+}
+
+#ifndef _WIN32
+/*
+ * Whether name, a file in dir, is the per-ABI store <stem>.<abi>.blob of a
+ * primary <stem>.blob in the same directory. Opening the primary store opens
+ * it already, and on its own it has no index.
+ */
+bool
+is_sibling_store(const char *dir, const char *name)
+{
+    const size_t len = strlen(name);
+    const size_t ext = sizeof(".blob") - 1;
+
+    if (len <= ext || strcmp(name + len - ext, ".blob") != 0)
+        return false;
+
+    size_t stem_len = len - ext;
+    while (stem_len && name[stem_len - 1] != '.')
+        stem_len--;
+
+    char abi[STORE_ABI_SIZE];
+    if (stem_len < 2 || !store_sibling_abi(name, len, name, stem_len - 1, abi))
+        return false;
+
+    const size_t primary_len = strlen(dir) + 1 + (stem_len - 1) + ext;
+    char *primary = malloc(primary_len + 1);
+    if (!primary) return false;
+
+    snprintf(primary, primary_len + 1, "%s/%.*s.blob", dir, (int)(stem_len - 1), name);
+
+    struct stat st;
+    const bool found = lstat(primary, &st) == 0 && S_ISREG(st.st_mode);
+    free(primary);
+
+    return found;
+}
+
+/*
+ * Collects every *.blob, *.apk and *.aab file below dir, except the per-ABI
+ * stores of a primary store collected with it. Symbolic links are not
+ * followed so a link cycle cannot make the walk loop.
+ */
+int
+collect_blobs(const char *dir, path_list_T *list)
+{
+    DIR *handle = opendir(dir);
+    if (!handle)
+    {
+        fprintf(stderr, "opendir() failed for %s\n", dir);
+        return -1;
     }
 
-    for (size_t i = 0; i < header.index_entry_count; i++)
+    const size_t dir_len = strlen(dir);
+    struct dirent *ent = NULL;
+
+    while ((ent = readdir(handle)) != NULL)
     {
-        if (fread(
-                &hash64list[i],
-                sizeof(hash_T),
-                1,
-                file) != 1)
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+            continue;
+
+        const size_t len = dir_len + 1 + strlen(ent->d_name);
+        char *child = malloc(len + 1);
+        if (!child) break;
+
+        snprintf(child, len + 1, "%s/%s", dir, ent->d_name);
+
+        struct stat st;
+        if (lstat(child, &st) == 0)
         {
-            fprintf(stderr, "fread() failed fie:%s:%d\n", __FILE__, __LINE__);
-            goto EXIT;
+            if (S_ISDIR(st.st_mode))
+                collect_blobs(child, list);
+            else if (S_ISREG(st.st_mode) && has_blob_ext(ent->d_name) && !is_sibling_store(dir, ent->d_name))
+                path_list_add(list, child, len);
         }
+
+        free(child);
     }
 
-    fpos = ftell(file);
+    closedir(handle);
 
-    for (size_t i = 0; i < header.index_entry_count; i++)
-    {
-        hash_T* hash = get_hash(hash32list, count, i);
-	if (!hash)
-	{
-		fprintf(stderr, "Failed getting hash object for index 0x%lx\n", i);
-		continue;
-	}
-        descriptor_T* dsc = get_descriptor(descriptors, count, hash->local_store_index);
-	if (!dsc)
-	{
-		fprintf(stderr, "Failed getting descriptor object for local store index 0x%x\n", hash->local_store_index);
-		continue;
-	}
+    return 0;
+}
+#endif
 
-	char* dllname = NULL;
-	char hexdllname[16] = { 0 };
-	sprintf(hexdllname, "0x%x.dll", hash->hash32);
+/*
+ * Reads one blob path per line, blank lines and lines starting with '#' are
+ * skipped.
+ */
+int
+read_list_file(const char *path, path_list_T *list)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        fprintf(stderr, "Failed opening list file %s\n", path);
+        return -1;
+    }
 
-	if (has_manifest)
-		dllname = get_dllname_from_manifest(*block, manifest, hash->hash32);
-	else
-		dllname = (char*)&hexdllname;
+    char line[4096];
+    while (fgets(line, sizeof(line), file))
+    {
+        size_t len = strcspn(line, "\r\n");
+        if (!len || line[0] == '#') continue;
 
+        path_list_add(list, line, len);
+    }
 
-        fseek((FILE*)file, dsc->data_offset, SEEK_SET);
-        fpos = ftell(file);
+    fclose(file);
 
-        xalz_T xalz = { 0 };
-        if (fread(
-                &xalz,
-                sizeof(xalz_T),
-                1,
-                file) != 1)
-        {
-            fprintf(stderr, "fread() failed fie:%s:%d\n", __FILE__, __LINE__);
-	    continue;
-        }
+    return 0;
+}
 
-        if (is_debug)
-        {
-            fprintf(stdout, "file: %s pos: 0x%zx index: %d magic: 0x%x xalz.size: 0x%x data_offset: 0x%x data_size: %d\n",
-                    dllname, fpos, hash->local_store_index, xalz.magic, xalz.size, dsc->data_offset, dsc->data_size);
-        }
+typedef struct {
+    path_list_T *paths;
+    block_T **blocks;
+    const dump_options_T *options;
+    blob_cb_T on_blob;
+    void *ctx;
+    size_t done;
+    mutex_T lock;
+} batch_T;
 
-	if (xalz.magic != 0x5a4c4158)
-	{
-            fprintf(stderr, "Bailing invalid XALZ magic signature found\n");
-	    continue;
-	}
+void
+batch_blob(void *ctx, const size_t index, const size_t worker)
+{
+    batch_T *batch = ctx;
+    const char *path = batch->paths->items[index];
 
-        if (xalz.size <= 0)
-	{
-	    // Skip extraction of the file
-            fprintf(stderr, "Bailing invalid XALZ payload size value\n");
-	    continue;
-	}
+    // Blobs are the unit of parallelism here, each one is decoded serially
+    // into the arena owned by the worker.
+    dump_options_T options = *batch->options;
+    dump_stats_T stats = { 0 };
+    options.jobs = 1;
+    options.on_entry = NULL;
+    options.ctx = NULL;
+    options.stats = &stats;
 
+    assembly_table_T table = { 0 };
+    size_t count = dump_blob(&batch->blocks[worker], path, &table, &options);
 
-        list_append(block, list, dllname, xalz.size);
+    mutex_lock(&batch->lock);
 
-        size_t compressed_file_size = dsc->data_size;
-        char* compressed_payload = block_alloc(*block, compressed_file_size);
-        if (!compressed_payload)
-        {
-	    fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
-            goto EXIT;
-        }
+    // A blob whose index was read counts even when the filters left nothing.
+    if (count > 0 || stats.entries > 0)
+        batch->done++;
 
-        if (fread(
-                compressed_payload,
-                compressed_file_size,
-                1,
-                file) < 1)
-        {
-			if(!feof(file))
-			{
-            	fprintf(stderr, "Failed reading file 2\n");
-            	goto EXIT;
-			}
-        }
+    if (batch->options->stats)
+        stats_add(batch->options->stats, &stats);
 
-        size_t data_size = xalz.size;
-        char *data = block_alloc(*block, data_size);
-        if (!data)
-        {
-            fprintf(stderr, "block_alloc() failed file:%s:%d\n", __FILE__, __LINE__);
-            goto EXIT;
-        }
+    if (batch->on_blob)
+        batch->on_blob(path, &table, batch->ctx);
 
-        int ret =  LZ4_decompress_fast(compressed_payload, data, (int)data_size);
-        if (ret <= 0)
-        {
-            fprintf(stderr, "LZ4 decompression failed\n");
-            goto EXIT;
-        }
+    mutex_unlock(&batch->lock);
+}
 
-        const char *dir = get_parent_dir(*block, path);
-        string_T *output = (dir) ? string_concat(*block, dir, dllname) : string_new(*block, dllname);
+size_t
+dabu_dump_many(
+	const char *source,
+	const dump_options_T *options,
+	blob_cb_T on_blob,
+	void *ctx)
+{
+    if (!source || !*source || !options) return 0;
 
-        if (!output)
-        {
-            fprintf(stderr, "string operation failed\n");
-            goto EXIT;
-        }
+    if (options->archive)
+    {
+        fprintf(stderr, "archive output is not supported when dumping many blobs\n");
+        return 0;
+    }
 
-        if (dump)
-        {
-            ret = write_file(output->buffer, data, data_size);
-            if (ret <= 0)
-            {
-                fprintf(stderr, "write_file() failed\n");
-                goto EXIT;
-            }
-        }
+    path_list_T paths = { 0 };
 
+#ifndef _WIN32
+    struct stat st;
+    if (stat(source, &st) < 0)
+    {
+        fprintf(stderr, "Failed opening %s\n", source);
+        return 0;
     }
 
-EXIT:
-    if (file)
+    if (S_ISDIR(st.st_mode))
+        collect_blobs(source, &paths);
+    else
+        read_list_file(source, &paths);
+#else
+    read_list_file(source, &paths);
+#endif
+
+    if (!paths.count)
     {
-        fclose(file);
-        file = NULL;
+        path_list_free(&paths);
+        return 0;
     }
 
-    if (manifest)
+    const size_t workers = (options->jobs > 1) ? options->jobs : 1;
+
+    // Per-blob counters are summed into the caller's stats, the arena peak
+    // is the largest single blob.
+    if (options->stats)
+        memset(options->stats, 0, sizeof(dump_stats_T));
+
+    batch_T batch = { 0 };
+    batch.paths = &paths;
+    batch.options = options;
+    batch.on_blob = on_blob;
+    batch.ctx = ctx;
+    batch.blocks = calloc(workers, sizeof(block_T*));
+
+    if (!batch.blocks)
     {
-        fclose(manifest);
-        manifest = NULL;
+        path_list_free(&paths);
+        return 0;
     }
 
-	return count;
-}
+    mutex_init(&batch.lock);
+    run_parallel(paths.count, (unsigned int)workers, batch_blob, &batch);
+    mutex_destroy(&batch.lock);
+
+    for (size_t i = 0; i < workers; i++)
+        block_free(&batch.blocks[i]);
 
+    free(batch.blocks);
+    path_list_free(&paths);
+
+    return batch.done;
+}
@@ -5,6 +5,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef struct assembly_T {
     char name[MAX_NAME];
@@ -12,11 +13,246 @@ typedef struct assembly_T {
     struct assembly_T *next;
 } assembly_T;
 
+/*
+ * Compact per-assembly record. name and data point into the block_T arena and
+ * stay valid until the block is freed. Entries of per-ABI stores
+ * (assemblies.<abi>.blob) carry the store's abi, it is NULL for the primary
+ * store. The debug symbols and .config payloads of the descriptor are only
+ * decoded when asked for (dump_options_T.debug_data/config_data): debug and
+ * config then point into the arena, NULL when the entry has none.
+ * compressed is false for assemblies stored as plain PE images, their size
+ * is data_size. object is the path of the assembly in the content store
+ * (dump_options_T.cas), relative to its root. Entries of dabu_open_cached()
+ * whose assembly is in the decode cache have data pointing into the cache
+ * file, valid until dabu_close().
+ */
+typedef struct assembly_entry_T {
+    const char *name;
+    uint32_t name_len;
+    uint32_t index;
+    uint32_t hash32;
+    uint64_t hash64;
+    uint32_t data_offset;
+    uint32_t data_size;
+    uint32_t size;
+    uint32_t store_id;
+    const char *abi;
+    bool compressed;
+    const uint8_t *data;
+    uint32_t debug_data_offset;
+    uint32_t debug_data_size;
+    uint32_t config_data_offset;
+    uint32_t config_data_size;
+    uint32_t debug_size;
+    uint32_t config_size;
+    const uint8_t *debug;
+    const uint8_t *config;
+    const char *object;
+} assembly_entry_T;
+
+typedef struct assembly_table_T {
+    assembly_entry_T *entries;
+    size_t count;
+} assembly_table_T;
+
+/*
+ * Options for assemblies_dump_options(). A zeroed struct behaves like
+ * assemblies_dump_table(..., false).
+ *   dump: write every assembly next to the blob
+ *   jobs: number of threads used for decompression, 0 or 1 runs serially
+ *   list_only: resolve names and sizes from the XALZ headers without reading
+ *              or decompressing payloads, entries have no data. Ignored when
+ *              dump is set.
+ *   on_entry: called for every entry as soon as it is ready, in index order
+ *             and never concurrently, with ctx as last argument.
+ *   stats: when set, filled with the counters of the call.
+ *   writers: with dump, number of threads writing the decoded assemblies
+ *            to disk while decompression goes on. 0 writes from the
+ *            decompression threads. Ignored on Windows.
+ *   preallocate: reserve each output file's final size with fallocate()
+ *                before writing it (Linux).
+ *   direct_io: write output files with O_DIRECT, bypassing the page cache,
+ *              where the file system supports it.
+ *   archive: write every decoded assembly, in index order, into a single
+ *            ustar archive at this path, "-" for stdout. Implies decoding
+ *            the payloads. Not supported by dabu_dump_many().
+ *   include, exclude: NULL terminated lists of name patterns. An entry is
+ *             kept when it matches any include pattern (or none are given)
+ *             and no exclude pattern. Patterns are shell globs matched
+ *             against the whole name ("System.*.dll"), or POSIX extended
+ *             regular expressions when prefixed with "re:". Filtered out
+ *             entries are never read nor decompressed.
+ *   debug_data, config_data: also decode each entry's debug symbols (.pdb)
+ *             and .config payload, decompressing XALZ wrapped ones, in the
+ *             same offset ordered pass as the assembly. With dump and
+ *             archive they are written as <name>.pdb and <name>.dll.config.
+ *             Ignored with list_only.
+ *   cas: root of a content addressed store. Every decoded assembly is
+ *        written once as <cas>/<aa>/<key>, key being the hex xxh64 of its
+ *        bytes (cas_sha256: their SHA-256) and aa its first two digits;
+ *        assemblies already there are not written again. With dump the
+ *        extracted files are copies of the objects, reflinked where the
+ *        file system supports it. Implies decoding.
+ *   cas_hardlink: with cas and dump, make the extracted files hard links
+ *        to the objects instead. Editing such a file in place changes the
+ *        object for every blob that shares it.
+ *   cache: directory of the decode cache. A blob is identified by its size
+ *          and a hash of its header, descriptors, index and manifest; the
+ *          entry table of a blob seen before is read back from
+ *          <cache>/<fingerprint>.dabc instead of the manifest and the XALZ
+ *          headers, and a missing cache file is written once the call is
+ *          done.
+ *   cache_data: also keep the decoded assemblies in the cache file. Cached
+ *          assemblies are copied, or written file to file, instead of being
+ *          decompressed again. Implies decoding.
+ */
+typedef void (*entry_cb_T)(const assembly_entry_T *, void *);
+
+/*
+ * Where a dump spent its time. Payload I/O, decode and write times are summed
+ * over the decode workers, so with jobs > 1 they can exceed total_seconds.
+ *   table_seconds: header, descriptor and hash table reads
+ *   manifest_seconds: manifest parsing and name resolution
+ *   io_seconds: XALZ headers and compressed payload reads
+ *   decode_seconds: LZ4 decompression
+ *   write_seconds: extraction to disk
+ *   entries: records of the blob's hash index; an assembly built for
+ *            several ABIs is one record but one listed entry per ABI
+ *   decoded: assemblies decompressed or copied out of the store, those read
+ *            back from the decode cache are only counted in cached
+ *   deduplicated: assemblies already present in the content store
+ *   cached: assemblies read back from the decode cache
+ */
+typedef struct dump_stats_T {
+    double table_seconds;
+    double manifest_seconds;
+    double io_seconds;
+    double decode_seconds;
+    double write_seconds;
+    double total_seconds;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t bytes_written;
+    size_t entries;
+    size_t listed;
+    size_t decoded;
+    size_t failed;
+    size_t skipped;
+    size_t deduplicated;
+    size_t cached;
+    size_t arena_peak;
+} dump_stats_T;
+
+typedef struct dump_options_T {
+    bool dump;
+    unsigned int jobs;
+    bool list_only;
+    entry_cb_T on_entry;
+    void *ctx;
+    dump_stats_T *stats;
+    const char *const *include;
+    const char *const *exclude;
+    unsigned int writers;
+    bool preallocate;
+    bool direct_io;
+    const char *archive;
+    bool debug_data;
+    bool config_data;
+    const char *cas;
+    bool cas_sha256;
+    bool cas_hardlink;
+    const char *cache;
+    bool cache_data;
+} dump_options_T;
+
 typedef struct block_T block_T;
 
+typedef struct dabu_T dabu_T;
+
 size_t
 assemblies_dump(block_T **, const char *, assembly_T **, const bool);
 
+size_t
+assemblies_dump_table(block_T **, const char *, assembly_table_T *, const bool);
+
+size_t
+assemblies_dump_options(block_T **, const char *, assembly_table_T *, const dump_options_T *);
+
+/*
+ * Dumps every blob listed by source: either a directory, walked recursively
+ * for *.blob, *.apk and *.aab files, or a text file with one blob path per
+ * line. Per-ABI stores found next to their primary store are read with it.
+ * options->jobs blobs are processed concurrently, each worker reusing one
+ * arena across its blobs. on_blob is called once per blob, never
+ * concurrently; the table is only valid during the call and on_entry is not
+ * used. stats, when set, sums the counters of every blob. Returns the number
+ * of blobs read, including those where the filters left no entry.
+ */
+typedef void (*blob_cb_T)(const char *, const assembly_table_T *, void *);
+
+size_t
+dabu_dump_many(const char *, const dump_options_T *, blob_cb_T, void *);
+
+/*
+ * Random access to a blob. dabu_open() parses the header, the descriptors
+ * and the hash tables only; entries are decompressed on demand by
+ * dabu_read(), which returns the number of bytes written to the buffer or 0
+ * on failure. dabu_entry() returns NULL for entries that cannot be decoded.
+ */
+dabu_T*
+dabu_open(const char *path);
+
+/*
+ * dabu_open() through the decode cache in the cache directory (see
+ * dump_options_T.cache). When the blob is cached no XALZ header is read for
+ * the entries the cache file holds, and entries whose assembly is cached
+ * have data pointing into the cache file, dabu_read() copies it from there.
+ * Entries are still resolved on first use; dabu_close() writes the cache
+ * file when entries were resolved that it did not hold yet.
+ */
+dabu_T*
+dabu_open_cached(const char *path, const char *cache);
+
+size_t
+dabu_count(const dabu_T *);
+
+const assembly_entry_T*
+dabu_entry(dabu_T *, const size_t);
+
+size_t
+dabu_read(dabu_T *, const size_t, void *, const size_t);
+
+/*
+ * Name of an entry from the manifest or the cache file, without reading its
+ * XALZ header. NULL when the index is out of range.
+ */
+const char*
+dabu_name(const dabu_T *, const size_t);
+
+/*
+ * Looks an assembly up by name through the blob's sorted hash64 and hash32
+ * index tables, without the manifest. Both "Foo.Bar.dll" and "Foo.Bar" are
+ * accepted, as are extracted satellite names ("fr_Foo.resources.dll").
+ * Returns the entry index for dabu_entry()/dabu_read() or DABU_NOT_FOUND.
+ */
+#define DABU_NOT_FOUND ((size_t)-1)
+
+size_t
+dabu_find(dabu_T *, const char *);
+
+/*
+ * The index hashes of an assembly name: xxHash32 and xxHash64 with seed 0
+ * over the name without its ".dll" extension.
+ */
+uint32_t
+dabu_hash32(const char *);
+
+uint64_t
+dabu_hash64(const char *);
+
+void
+dabu_close(dabu_T **);
+
 void
 block_free(block_T **block);
 
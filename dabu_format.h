@@ -0,0 +1,58 @@
+#ifndef _DABU_FORMAT_H
+#define _DABU_FORMAT_H
+
+#include <stdint.h>
+
+/*
+ * On-disk layout of an AssemblyStore (format v1): header, descriptors, the
+ * hash32 and hash64 index of the primary store, then the payloads, each one
+ * either an XALZ wrapped LZ4 image or a plain PE image. Internal to dabu and
+ * its tools, not part of the public API in dabu.h.
+ */
+
+#define XABA_MAGIC 0x41424158
+#define XALZ_MAGIC 0x5a4c4158
+
+#pragma pack(push, 1)
+typedef struct header_T {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t index_entry_count;
+    // Called index_size in older notes; format v1 stores the store id here.
+    uint32_t store_id;
+} header_T;
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+typedef struct descriptor_T {
+    uint32_t data_offset;
+    uint32_t data_size;
+    uint32_t debug_data_offset;
+    uint32_t debug_data_size;
+    uint32_t config_data_offset;
+    uint32_t config_data_size;
+} descriptor_T;
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+typedef struct hash_T {
+    union {
+        uint32_t hash32;
+        uint64_t hash64;
+    };
+    uint32_t mapping_index;
+    uint32_t local_store_index;
+    uint32_t store_id;
+} hash_T;
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+typedef struct {
+    uint32_t magic;
+    uint32_t index;
+    uint32_t size;
+} xalz_T;
+#pragma pack(pop)
+
+#endif
@@ -3,6 +3,421 @@
 
 #include "../dabu.h"
 
+#define ARENA_CAPSULE "dabu.arena"
+
+/*
+ * Read-only buffer over a slice of a block_T arena. It holds a reference on
+ * the capsule that owns the arena, so memoryviews created from it keep the
+ * arena alive.
+ */
+typedef struct {
+    PyObject_HEAD
+    PyObject *owner;
+    const void *buf;
+    Py_ssize_t len;
+} ArenaBuffer;
+
+static int ArenaBuffer_getbuffer(PyObject *self, Py_buffer *view, int flags) {
+    ArenaBuffer *buffer = (ArenaBuffer*)self;
+    return PyBuffer_FillInfo(view, self, (void*)buffer->buf, buffer->len, 1, flags);
+}
+
+static void ArenaBuffer_dealloc(PyObject *self) {
+    ArenaBuffer *buffer = (ArenaBuffer*)self;
+    Py_XDECREF(buffer->owner);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static PyBufferProcs ArenaBuffer_as_buffer = {
+    ArenaBuffer_getbuffer,
+    NULL
+};
+
+static PyTypeObject ArenaBufferType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "dabu.ArenaBuffer",
+    .tp_basicsize = sizeof(ArenaBuffer),
+    .tp_dealloc = ArenaBuffer_dealloc,
+    .tp_as_buffer = &ArenaBuffer_as_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Read-only view on a payload held in a dabu arena",
+};
+
+static void arena_capsule_destructor(PyObject *capsule) {
+    block_T *block = PyCapsule_GetPointer(capsule, ARENA_CAPSULE);
+    block_free(&block);
+}
+
+static PyObject* arena_memoryview(PyObject *owner, const void *buf, Py_ssize_t len) {
+    ArenaBuffer *buffer = PyObject_New(ArenaBuffer, &ArenaBufferType);
+    if (!buffer)
+        return NULL;
+
+    Py_INCREF(owner);
+    buffer->owner = owner;
+    buffer->buf = buf;
+    buffer->len = len;
+
+    PyObject *view = PyMemoryView_FromObject((PyObject*)buffer);
+    Py_DECREF(buffer);
+
+    return view;
+}
+
+static int dict_set(PyObject *dict, const char *key, PyObject *value) {
+    if (!value)
+        return -1;
+
+    int ret = PyDict_SetItemString(dict, key, value);
+    Py_DECREF(value);
+
+    return ret;
+}
+
+/*
+ * dabu.Blob: a store opened once with dabu_open(). Entries are listed up
+ * front from the index tables and the manifest; an entry's XALZ header is
+ * only read when its metadata is first accessed, and its payload only
+ * decompressed when its data is.
+ */
+typedef struct {
+    PyObject_HEAD
+    dabu_T *handle;
+    Py_ssize_t count;
+    PyObject *names;
+    PyObject *cache;
+} Blob;
+
+/*
+ * Entries only reference their blob; decoded data is cached on the blob so
+ * there is no reference cycle between the two.
+ */
+typedef struct {
+    PyObject_HEAD
+    Blob *blob;
+    size_t index;
+} Entry;
+
+static PyTypeObject EntryType;
+
+static void Entry_dealloc(PyObject *self) {
+    Entry *entry = (Entry*)self;
+    Py_XDECREF(entry->blob);
+    Py_TYPE(self)->tp_free(self);
+}
+
+/*
+ * Resolves the entry on first use. Entries that cannot be decoded raise
+ * ValueError.
+ */
+static const assembly_entry_T* Entry_get(Entry *entry) {
+    const assembly_entry_T *meta = dabu_entry(entry->blob->handle, entry->index);
+
+    if (!meta)
+        PyErr_Format(PyExc_ValueError, "%s cannot be decoded", dabu_name(entry->blob->handle, entry->index));
+
+    return meta;
+}
+
+static PyObject* Entry_name(PyObject *self, void *closure) {
+    Entry *entry = (Entry*)self;
+    return PyUnicode_FromString(dabu_name(entry->blob->handle, entry->index));
+}
+
+static PyObject* Entry_size(PyObject *self, void *closure) {
+    const assembly_entry_T *entry = Entry_get((Entry*)self);
+    return entry ? PyLong_FromUnsignedLong(entry->size) : NULL;
+}
+
+static PyObject* Entry_hash32(PyObject *self, void *closure) {
+    const assembly_entry_T *entry = Entry_get((Entry*)self);
+    return entry ? PyLong_FromUnsignedLong(entry->hash32) : NULL;
+}
+
+static PyObject* Entry_hash64(PyObject *self, void *closure) {
+    const assembly_entry_T *entry = Entry_get((Entry*)self);
+    return entry ? PyLong_FromUnsignedLongLong(entry->hash64) : NULL;
+}
+
+static PyObject* Entry_store_index(PyObject *self, void *closure) {
+    const assembly_entry_T *entry = Entry_get((Entry*)self);
+    return entry ? PyLong_FromUnsignedLong(entry->index) : NULL;
+}
+
+static PyObject* Entry_abi(PyObject *self, void *closure) {
+    const assembly_entry_T *entry = Entry_get((Entry*)self);
+
+    if (!entry)
+        return NULL;
+
+    if (!entry->abi)
+        Py_RETURN_NONE;
+
+    return PyUnicode_FromString(entry->abi);
+}
+
+static PyObject* Entry_data(PyObject *self, void *closure) {
+    Entry *entry = (Entry*)self;
+    PyObject *cached = PyList_GET_ITEM(entry->blob->cache, (Py_ssize_t)entry->index);
+
+    if (cached == Py_None)
+    {
+        const assembly_entry_T *meta = Entry_get(entry);
+        if (!meta)
+            return NULL;
+
+        PyObject *data = PyBytes_FromStringAndSize(NULL, meta->size);
+        if (!data)
+            return NULL;
+
+        size_t ret = 0;
+
+        Py_BEGIN_ALLOW_THREADS
+        ret = dabu_read(entry->blob->handle, entry->index, PyBytes_AS_STRING(data), meta->size);
+        Py_END_ALLOW_THREADS
+
+        if (ret != meta->size)
+        {
+            Py_DECREF(data);
+            PyErr_Format(PyExc_ValueError, "failed decompressing %s", meta->name);
+            return NULL;
+        }
+
+        PyList_SetItem(entry->blob->cache, (Py_ssize_t)entry->index, data);
+        cached = data;
+    }
+
+    Py_INCREF(cached);
+    return cached;
+}
+
+static PyObject* Entry_repr(PyObject *self) {
+    const assembly_entry_T *entry = Entry_get((Entry*)self);
+
+    if (!entry)
+    {
+        PyErr_Clear();
+        return PyUnicode_FromFormat("<dabu.Entry name='%s' invalid>", dabu_name(((Entry*)self)->blob->handle, ((Entry*)self)->index));
+    }
+
+    return PyUnicode_FromFormat("<dabu.Entry name='%s' size=%u>", entry->name, entry->size);
+}
+
+static PyGetSetDef Entry_getset[] = {
+    {"name", Entry_name, NULL, "file name of the assembly", NULL},
+    {"size", Entry_size, NULL, "decompressed size, read from the XALZ header on first access", NULL},
+    {"hash32", Entry_hash32, NULL, "32-bit name hash", NULL},
+    {"hash64", Entry_hash64, NULL, "64-bit name hash", NULL},
+    {"index", Entry_store_index, NULL, "local store index", NULL},
+    {"abi", Entry_abi, NULL, "ABI of the per-ABI store holding the assembly, None for the primary store", NULL},
+    {"data", Entry_data, NULL, "decompressed bytes, decoded on first access and cached", NULL},
+    {NULL}
+};
+
+static PyTypeObject EntryType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "dabu.Entry",
+    .tp_basicsize = sizeof(Entry),
+    .tp_dealloc = Entry_dealloc,
+    .tp_repr = Entry_repr,
+    .tp_getset = Entry_getset,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "An assembly of a dabu.Blob",
+};
+
+static int Blob_init(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "path", "cache", NULL };
+    Blob *blob = (Blob*)self;
+    const char *path = NULL;
+    const char *cache = NULL;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|z", keywords, &path, &cache))
+        return -1;
+
+    if (blob->handle)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "Blob is already open");
+        return -1;
+    }
+
+    dabu_T *handle = NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    handle = dabu_open_cached(path, cache);
+    Py_END_ALLOW_THREADS
+
+    if (!handle)
+    {
+        PyErr_Format(PyExc_ValueError, "failed opening assemblies blob %s", path);
+        return -1;
+    }
+
+    blob->handle = handle;
+    blob->count = (Py_ssize_t)dabu_count(handle);
+    blob->names = PyDict_New();
+    blob->cache = PyList_New(blob->count);
+    if (!blob->names || !blob->cache)
+        return -1;
+
+    // Split-ABI stores hold an assembly once per ABI, its name maps to the
+    // first one.
+    for (Py_ssize_t i = 0; i < blob->count; i++)
+    {
+        PyObject *name = PyUnicode_FromString(dabu_name(handle, (size_t)i));
+        PyObject *position = PyLong_FromSsize_t(i);
+
+        if (!name || !position || PyDict_SetDefault(blob->names, name, position) == NULL)
+        {
+            Py_XDECREF(name);
+            Py_XDECREF(position);
+            return -1;
+        }
+
+        Py_DECREF(name);
+        Py_DECREF(position);
+
+        Py_INCREF(Py_None);
+        PyList_SET_ITEM(blob->cache, i, Py_None);
+    }
+
+    return 0;
+}
+
+static void Blob_dealloc(PyObject *self) {
+    Blob *blob = (Blob*)self;
+    Py_XDECREF(blob->names);
+    Py_XDECREF(blob->cache);
+    dabu_close(&blob->handle);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static Py_ssize_t Blob_len(PyObject *self) {
+    return ((Blob*)self)->count;
+}
+
+static PyObject* Blob_item(PyObject *self, Py_ssize_t i) {
+    Blob *blob = (Blob*)self;
+
+    if (i < 0)
+        i += blob->count;
+
+    if (i < 0 || i >= blob->count)
+    {
+        PyErr_SetString(PyExc_IndexError, "Blob index out of range");
+        return NULL;
+    }
+
+    Entry *entry = PyObject_New(Entry, &EntryType);
+    if (!entry)
+        return NULL;
+
+    Py_INCREF(self);
+    entry->blob = blob;
+    entry->index = (size_t)i;
+
+    return (PyObject*)entry;
+}
+
+/*
+ * Position of an assembly by name: the manifest names first, then the blob's
+ * hash index, which also finds entries the manifest does not name. Returns
+ * -1 when missing, -2 with an exception set on error.
+ */
+static Py_ssize_t Blob_position(Blob *blob, PyObject *key) {
+    PyObject *position = PyDict_GetItemWithError(blob->names, key);
+    if (position)
+        return PyLong_AsSsize_t(position);
+
+    if (PyErr_Occurred())
+        return -2;
+
+    const char *name = PyUnicode_AsUTF8(key);
+    if (!name)
+        return -2;
+
+    const size_t index = dabu_find(blob->handle, name);
+    if (index == DABU_NOT_FOUND)
+        return -1;
+
+    return (Py_ssize_t)index;
+}
+
+static PyObject* Blob_subscript(PyObject *self, PyObject *key) {
+    Blob *blob = (Blob*)self;
+
+    if (PyUnicode_Check(key))
+    {
+        Py_ssize_t position = Blob_position(blob, key);
+        if (position < 0)
+        {
+            if (position == -1)
+                PyErr_SetObject(PyExc_KeyError, key);
+            return NULL;
+        }
+
+        return Blob_item(self, position);
+    }
+
+    if (PyIndex_Check(key))
+    {
+        Py_ssize_t i = PyNumber_AsSsize_t(key, PyExc_IndexError);
+        if (i == -1 && PyErr_Occurred())
+            return NULL;
+
+        return Blob_item(self, i);
+    }
+
+    PyErr_SetString(PyExc_TypeError, "Blob indices must be integers or assembly names");
+    return NULL;
+}
+
+static int Blob_contains(PyObject *self, PyObject *key) {
+    Blob *blob = (Blob*)self;
+
+    if (!PyUnicode_Check(key))
+        return 0;
+
+    Py_ssize_t position = Blob_position(blob, key);
+    if (position == -2)
+        return -1;
+
+    return position >= 0;
+}
+
+static PyObject* Blob_names(PyObject *self, PyObject *unused) {
+    return PyDict_Keys(((Blob*)self)->names);
+}
+
+static PyMethodDef Blob_methods[] = {
+    {"names", Blob_names, METH_NOARGS, "Returns the names of the assemblies in the blob."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PySequenceMethods Blob_as_sequence = {
+    .sq_length = Blob_len,
+    .sq_item = Blob_item,
+    .sq_contains = Blob_contains,
+};
+
+static PyMappingMethods Blob_as_mapping = {
+    .mp_length = Blob_len,
+    .mp_subscript = Blob_subscript,
+};
+
+static PyTypeObject BlobType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "dabu.Blob",
+    .tp_basicsize = sizeof(Blob),
+    .tp_dealloc = Blob_dealloc,
+    .tp_as_sequence = &Blob_as_sequence,
+    .tp_as_mapping = &Blob_as_mapping,
+    .tp_methods = Blob_methods,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Blob(path, cache=None) opens an assemblies.blob lazily: len(), iteration, blob[i] and blob[name] return entries that read their XALZ header and decompress their data on first access, and raise ValueError then when they cannot be decoded. cache names a decode cache directory, written when the blob is released.",
+    .tp_init = Blob_init,
+    .tp_new = PyType_GenericNew,
+};
+
 static PyObject* dabu_dump(PyObject* self, PyObject* args) {
     const char *path = NULL;
     int dump = 0;
@@ -16,68 +431,269 @@ static PyObject* dabu_dump(PyObject* self, PyObject* args) {
 
     block_T *block = NULL;
     assembly_T *assembly_list = NULL;
+    size_t count = 0;
 
-    size_t count = assemblies_dump(&block, path, &assembly_list, dump);
+    // Parsing, decompression and extraction do not touch Python objects.
+    Py_BEGIN_ALLOW_THREADS
+    count = assemblies_dump(&block, path, &assembly_list, dump);
+    Py_END_ALLOW_THREADS
 
     if (!assembly_list || count == 0)
+    {
+        block_free(&block);
         return PyList_New(0);
+    }
 
     PyObject *list = PyList_New(0);
 
     if (!list)
+    {
+        block_free(&block);
         return PyList_New(0);
+    }
 
-    assembly_T *iter = assembly_list;
-
-    while (iter)
+    for (assembly_T *iter = assembly_list; iter; iter = iter->next)
     {
+        // The list starts with an empty head node.
+        if (iter->name[0] == '\0' || !iter->size)
+            continue;
+
         PyObject *dict = PyDict_New();
         if (!dict)
         {
-            Py_XDECREF(list);
+            Py_DECREF(list);
+            block_free(&block);
             return PyList_New(0);
         }
 
-        if (iter->name[0] != '\0' || !iter->size)
-        {
-            iter = iter->next;
-        }
-
-        PyObject *name = PyUnicode_FromString(iter->name);
-        PyObject *size = PyLong_FromLong(iter->size);
-        if (!name || !size)
+        if (dict_set(dict, "name", PyUnicode_FromString(iter->name)) < 0
+                || dict_set(dict, "size", PyLong_FromSize_t(iter->size)) < 0
+                || PyList_Append(list, dict) < 0)
         {
-            Py_XDECREF(name);
-            Py_XDECREF(size);
             Py_DECREF(dict);
+            Py_DECREF(list);
+            block_free(&block);
             return PyList_New(0);
         }
 
-        PyDict_SetItemString(dict, "name", name);
-        PyDict_SetItemString(dict, "size", size);
+        Py_DECREF(dict);
+    }
+
+    block_free(&block);
 
-        Py_DECREF(name);
-        Py_DECREF(size);
+    return list;
+}
+
+/*
+ * Name patterns passed as a sequence of str, turned into the NULL terminated
+ * list dump_options_T expects. The sequence keeps the strings alive while
+ * the GIL is released.
+ */
+typedef struct {
+    PyObject *seq;
+    const char **list;
+} patterns_T;
+
+static void patterns_release(patterns_T *patterns) {
+    PyMem_Free(patterns->list);
+    Py_XDECREF(patterns->seq);
+    patterns->list = NULL;
+    patterns->seq = NULL;
+}
+
+static int patterns_convert(PyObject *obj, patterns_T *patterns) {
+    patterns->seq = NULL;
+    patterns->list = NULL;
+
+    if (!obj || obj == Py_None)
+        return 0;
+
+    if (PyUnicode_Check(obj)) {
+        PyErr_SetString(PyExc_TypeError, "patterns must be a sequence of str, not a str");
+        return -1;
+    }
+
+    patterns->seq = PySequence_Fast(obj, "patterns must be a sequence of str");
+    if (!patterns->seq)
+        return -1;
 
-        if (PyList_Append(list, dict) < 0)
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(patterns->seq);
+    patterns->list = PyMem_Calloc((size_t)n + 1, sizeof(char*));
+    if (!patterns->list) {
+        patterns_release(patterns);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(patterns->seq, i);
+        patterns->list[i] = PyUnicode_Check(item) ? PyUnicode_AsUTF8(item) : NULL;
+        if (!patterns->list[i]) {
+            if (!PyErr_Occurred())
+                PyErr_SetString(PyExc_TypeError, "patterns must be a sequence of str");
+            patterns_release(patterns);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static PyObject* dabu_load(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char *keywords[] = { "path", "jobs", "include", "exclude", "debug", "config", NULL };
+    const char *path = NULL;
+    unsigned int jobs = 0;
+    PyObject *include_obj = NULL;
+    PyObject *exclude_obj = NULL;
+    int debug = 0;
+    int config = 0;
+    patterns_T include = { 0 };
+    patterns_T exclude = { 0 };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|IOOpp", keywords, &path, &jobs, &include_obj, &exclude_obj, &debug, &config))
+        return NULL;
+
+    if (patterns_convert(include_obj, &include) < 0)
+        return NULL;
+
+    if (patterns_convert(exclude_obj, &exclude) < 0) {
+        patterns_release(&include);
+        return NULL;
+    }
+
+    block_T *block = NULL;
+    assembly_table_T table = { 0 };
+    dump_options_T options = { 0 };
+    options.jobs = jobs;
+    options.include = include.list;
+    options.exclude = exclude.list;
+    options.debug_data = debug;
+    options.config_data = config;
+    size_t count = 0;
+
+    Py_BEGIN_ALLOW_THREADS
+    count = assemblies_dump_options(&block, path, &table, &options);
+    Py_END_ALLOW_THREADS
+
+    patterns_release(&include);
+    patterns_release(&exclude);
+
+    if (!block)
+        return PyList_New(0);
+
+    // From here on the capsule owns the arena, every payload view holds it.
+    PyObject *owner = PyCapsule_New(block, ARENA_CAPSULE, arena_capsule_destructor);
+    if (!owner)
+    {
+        block_free(&block);
+        return NULL;
+    }
+
+    PyObject *list = PyList_New(0);
+    if (!list)
+    {
+        Py_DECREF(owner);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const assembly_entry_T *entry = &table.entries[i];
+
+        PyObject *dict = PyDict_New();
+        if (!dict
+                || dict_set(dict, "name", PyUnicode_FromStringAndSize(entry->name, entry->name_len)) < 0
+                || dict_set(dict, "size", PyLong_FromUnsignedLong(entry->size)) < 0
+                || dict_set(dict, "hash32", PyLong_FromUnsignedLong(entry->hash32)) < 0
+                || dict_set(dict, "hash64", PyLong_FromUnsignedLongLong(entry->hash64)) < 0
+                || dict_set(dict, "index", PyLong_FromUnsignedLong(entry->index)) < 0
+                || dict_set(dict, "abi", entry->abi ? PyUnicode_FromString(entry->abi) : (Py_INCREF(Py_None), Py_None)) < 0
+                || dict_set(dict, "data", arena_memoryview(owner, entry->data, entry->size)) < 0
+                || (debug && dict_set(dict, "debug", entry->debug
+                        ? arena_memoryview(owner, entry->debug, entry->debug_size) : (Py_INCREF(Py_None), Py_None)) < 0)
+                || (config && dict_set(dict, "config", entry->config
+                        ? arena_memoryview(owner, entry->config, entry->config_size) : (Py_INCREF(Py_None), Py_None)) < 0)
+                || PyList_Append(list, dict) < 0)
         {
-            Py_DECREF(dict);
+            Py_XDECREF(dict);
             Py_DECREF(list);
-            return PyList_New(0);
+            Py_DECREF(owner);
+            return NULL;
         }
 
         Py_DECREF(dict);
+    }
+
+    Py_DECREF(owner);
+
+    return list;
+}
+
+static PyObject* dabu_stats(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static char *keywords[] = { "path", "dump", "jobs", "list_only", "include", "exclude", NULL };
+    const char *path = NULL;
+    int dump = 0;
+    unsigned int jobs = 0;
+    int list_only = 0;
+    PyObject *include_obj = NULL;
+    PyObject *exclude_obj = NULL;
+    patterns_T include = { 0 };
+    patterns_T exclude = { 0 };
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|pIpOO", keywords, &path, &dump, &jobs, &list_only, &include_obj, &exclude_obj))
+        return NULL;
+
+    if (patterns_convert(include_obj, &include) < 0)
+        return NULL;
 
-        iter = iter->next;
+    if (patterns_convert(exclude_obj, &exclude) < 0) {
+        patterns_release(&include);
+        return NULL;
     }
 
+    block_T *block = NULL;
+    assembly_table_T table = { 0 };
+    dump_stats_T stats = { 0 };
+    dump_options_T options = { 0 };
+    options.dump = dump;
+    options.jobs = jobs;
+    options.list_only = list_only;
+    options.stats = &stats;
+    options.include = include.list;
+    options.exclude = exclude.list;
+
+    Py_BEGIN_ALLOW_THREADS
+    assemblies_dump_options(&block, path, &table, &options);
     block_free(&block);
+    Py_END_ALLOW_THREADS
 
-    return list;
+    patterns_release(&include);
+    patterns_release(&exclude);
+
+    return Py_BuildValue("{s:d,s:d,s:d,s:d,s:d,s:d,s:K,s:K,s:K,s:n,s:n,s:n,s:n,s:n,s:n,s:n,s:n}",
+            "table_seconds", stats.table_seconds,
+            "manifest_seconds", stats.manifest_seconds,
+            "io_seconds", stats.io_seconds,
+            "decode_seconds", stats.decode_seconds,
+            "write_seconds", stats.write_seconds,
+            "total_seconds", stats.total_seconds,
+            "bytes_in", (unsigned long long)stats.bytes_in,
+            "bytes_out", (unsigned long long)stats.bytes_out,
+            "bytes_written", (unsigned long long)stats.bytes_written,
+            "entries", (Py_ssize_t)stats.entries,
+            "listed", (Py_ssize_t)stats.listed,
+            "decoded", (Py_ssize_t)stats.decoded,
+            "failed", (Py_ssize_t)stats.failed,
+            "skipped", (Py_ssize_t)stats.skipped,
+            "deduplicated", (Py_ssize_t)stats.deduplicated,
+            "cached", (Py_ssize_t)stats.cached,
+            "arena_peak", (Py_ssize_t)stats.arena_peak);
 }
 
 static PyMethodDef methods[] = {
     {"dump", dabu_dump, METH_VARARGS, "Unpacks DLLs from the assemblies.blob file and returns a list of DLLs, or an empty list on failure."},
+    {"load", (PyCFunction)(void(*)(void))dabu_load, METH_VARARGS | METH_KEYWORDS, "load(path, jobs=0, include=None, exclude=None, debug=False, config=False) decompresses every assembly and returns a list of dicts whose 'data' is a read-only memoryview on the decompressed bytes, without copying them. With debug/config the dicts also carry the 'debug' symbols and 'config' payload, None when an assembly has none."},
+    {"stats", (PyCFunction)(void(*)(void))dabu_stats, METH_VARARGS | METH_KEYWORDS, "stats(path, dump=False, jobs=0, list_only=False, include=None, exclude=None) runs a dump and returns its per-phase timings and counters as a dict."},
     {NULL, NULL, 0, NULL}
 };
 
@@ -90,6 +706,30 @@ static struct PyModuleDef module = {
 };
 
 PyMODINIT_FUNC PyInit_dabu(void) {
-    return PyModule_Create(&module);
-}
+    if (PyType_Ready(&ArenaBufferType) < 0
+            || PyType_Ready(&EntryType) < 0
+            || PyType_Ready(&BlobType) < 0)
+        return NULL;
+
+    PyObject *mod = PyModule_Create(&module);
+    if (!mod)
+        return NULL;
 
+    Py_INCREF(&BlobType);
+    if (PyModule_AddObject(mod, "Blob", (PyObject*)&BlobType) < 0)
+    {
+        Py_DECREF(&BlobType);
+        Py_DECREF(mod);
+        return NULL;
+    }
+
+    Py_INCREF(&EntryType);
+    if (PyModule_AddObject(mod, "Entry", (PyObject*)&EntryType) < 0)
+    {
+        Py_DECREF(&EntryType);
+        Py_DECREF(mod);
+        return NULL;
+    }
+
+    return mod;
+}
@@ -1,10 +1,13 @@
+import os
 from setuptools import setup, Extension
 
+libraries = [] if os.name == "nt" else ["pthread"]
+
 setup(
     name="dabu",
     version="1.0",
     ext_modules=[
-        Extension("dabu", sources=["dabu_py.c", "../lz4.c", "../dabu.c" ]),
+        Extension("dabu", sources=["dabu_py.c", "../lz4.c", "../dabu.c" ], libraries=libraries),
     ],
 )
 
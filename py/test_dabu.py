@@ -0,0 +1,111 @@
+import os
+import sys
+import tempfile
+import unittest
+
+import dabu
+
+# Behavior checks of the binding on a store written by dabu_gen:
+#   test_dabu.py <blob> <entry count>
+# Every tenth assembly of such a store is a French satellite assembly.
+BLOB = None
+ENTRIES = 0
+
+def expected_name(index):
+	if index % 10 == 9:
+		return "fr_Bench.Assembly{}.resources.dll".format(index)
+	return "Bench.Assembly{}.dll".format(index)
+
+def decoded():
+	return {i["name"]: bytes(i["data"]) for i in dabu.load(BLOB, jobs=4)}
+
+class BlobTest(unittest.TestCase):
+	def test_entries(self):
+		blob = dabu.Blob(BLOB)
+		self.assertEqual(len(blob), ENTRIES)
+		self.assertEqual(sorted(blob.names()), sorted(expected_name(i) for i in range(ENTRIES)))
+
+		for entry in blob:
+			self.assertEqual(entry.name, expected_name(entry.index))
+			self.assertEqual(blob[entry.name].index, entry.index)
+			self.assertIsNone(entry.abi)
+
+	def test_lookup(self):
+		blob = dabu.Blob(BLOB)
+		self.assertEqual(blob["Bench.Assembly0.dll"].index, 0)
+		self.assertEqual(blob["Bench.Assembly0"].index, 0)
+		self.assertEqual(blob["fr_Bench.Assembly9.resources.dll"].index, 9)
+		self.assertIn("Bench.Assembly1.dll", blob)
+		self.assertNotIn("Missing.Assembly.dll", blob)
+		self.assertNotIn(1, blob)
+		self.assertEqual(blob[-1].name, blob[len(blob) - 1].name)
+
+		with self.assertRaises(KeyError):
+			blob["Missing.Assembly.dll"]
+		with self.assertRaises(IndexError):
+			blob[len(blob)]
+		with self.assertRaises(TypeError):
+			blob[1.5]
+
+	def test_data(self):
+		reference = decoded()
+		blob = dabu.Blob(BLOB)
+
+		for entry in blob:
+			data = entry.data
+			self.assertEqual(data, reference[entry.name])
+			self.assertEqual(len(data), entry.size)
+			self.assertIs(blob[entry.name].data, data)
+
+	def test_cache(self):
+		reference = decoded()
+
+		with tempfile.TemporaryDirectory() as cache:
+			# Only the entries a blob resolved are written when it is released.
+			blob = dabu.Blob(BLOB, cache=cache)
+			del blob
+			self.assertEqual(os.listdir(cache), [])
+
+			blob = dabu.Blob(BLOB, cache=cache)
+			self.assertEqual(blob[0].size, len(reference[blob[0].name]))
+			del blob
+			self.assertEqual(len(os.listdir(cache)), 1)
+
+			for _ in range(2):
+				blob = dabu.Blob(BLOB, cache=cache)
+				self.assertEqual({entry.name: entry.data for entry in blob}, reference)
+				del blob
+
+			self.assertEqual(len(os.listdir(cache)), 1)
+
+class StatsTest(unittest.TestCase):
+	def test_decode(self):
+		stats = dabu.stats(BLOB, jobs=2)
+		self.assertEqual(stats["entries"], ENTRIES)
+		self.assertEqual(stats["decoded"], ENTRIES)
+		self.assertEqual(stats["failed"], 0)
+		self.assertEqual(stats["bytes_out"], sum(len(data) for data in decoded().values()))
+		self.assertGreater(stats["total_seconds"], 0)
+
+	def test_list_only(self):
+		stats = dabu.stats(BLOB, list_only=True)
+		self.assertEqual(stats["listed"], ENTRIES)
+		self.assertEqual(stats["decoded"], 0)
+		self.assertEqual(stats["bytes_out"], 0)
+
+	def test_filters(self):
+		satellites = len([i for i in range(ENTRIES) if i % 10 == 9])
+		stats = dabu.stats(BLOB, include=["fr_*"])
+		self.assertEqual(stats["decoded"], satellites)
+		self.assertEqual(stats["skipped"], ENTRIES - satellites)
+
+		stats = dabu.stats(BLOB, exclude=["fr_*"])
+		self.assertEqual(stats["decoded"], ENTRIES - satellites)
+
+if __name__ == "__main__":
+	if (len(sys.argv) - 1) < 2:
+		print("{} <blob path> <entry count>".format(sys.argv[0]))
+		exit(2)
+	BLOB = sys.argv[1]
+	ENTRIES = int(sys.argv[2])
+	unittest.main(argv=sys.argv[:1])